@@ -0,0 +1,43 @@
+#ifndef _arena_h_
+#define _arena_h_
+#include <cstddef>
+#include <new>
+
+/**
+ * Contiguous storage for a fixed number of objects of type T. Object i
+ * is constructed in slot(i) with placement new, so many threads can
+ * fill the arena at once without locking. The objects must be destroyed
+ * before the arena is deleted, but their storage is released all at
+ * once by the arena. A class that is kept in an arena should give
+ * itself an operator delete that does nothing for pointers the arena
+ * owns.
+ */
+template <class T> class Arena
+{
+	public:
+		Arena(size_t count):
+			storage((char*)::operator new(count*sizeof(T))),
+			count(count)
+		{
+		}
+		/**
+		 * Get the memory for object i.
+		 */
+		void* slot(size_t i) { return storage+i*sizeof(T); }
+		/**
+		 * Is p in the arena?
+		 */
+		bool owns(const void* p) const
+		{
+			return (const char*)p >= storage && (const char*)p < storage+count*sizeof(T);
+		}
+		size_t size() const { return count; }
+		~Arena() { ::operator delete(storage); }
+	private:
+		Arena(const Arena&);
+		Arena& operator=(const Arena&);
+		char* storage;
+		const size_t count;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "Biopsy.h"
+#include <cstring>
+#include <algorithm>
+
+BiopsyIndex::BiopsyIndex(int nx, int ny, int depth):
+	nx(nx),ny(ny),depth(depth),
+	grade(nx*ny,NORMAL)
+{
+	for (int g = 0; g < NUM_CELL_TYPES; g++)
+		sums[g].resize((nx+1)*(ny+1),0);
+}
+
+void BiopsyIndex::clear()
+{
+	std::fill(grade.begin(),grade.end(),NORMAL);
+}
+
+void BiopsyIndex::add(const TissueGrid& grid)
+{
+	const Census& c = grid.census();
+	for (auto cell : c.non_normal())
+	{
+		int x, y, z;
+		c.position(cell,x,y,z);
+		add(x+grid.xorigin(),y+grid.yorigin(),z,grid.itype(x,y,z));
+	}
+}
+
+void BiopsyIndex::update()
+{
+	// Row and column zero of the sums are always zero
+	for (int g = 0; g < NUM_CELL_TYPES; g++)
+	{
+		std::vector<int>& s = sums[g];
+		for (int y = 0; y < ny; y++)
+		{
+			int row = 0;
+			for (int x = 0; x < nx; x++)
+			{
+				row += (grade[y*nx+x] == g);
+				s[(y+1)*(nx+1)+x+1] = s[y*(nx+1)+x+1]+row;
+			}
+		}
+	}
+}
+
+int BiopsyIndex::sample(int x, int y, int width, int length, int found[NUM_CELL_TYPES]) const
+{
+	int y1 = y+length;
+	if (y < 0) y = 0;
+	if (y1 > ny) y1 = ny;
+	x %= nx;
+	if (x < 0) x += nx;
+	if (width > nx) width = nx;
+	int worst = -1;
+	for (int g = 0; g < NUM_CELL_TYPES; g++)
+	{
+		found[g] = 0;
+		if (y >= y1)
+			continue;
+		// Split the biopsy where it wraps around the circumference
+		if (x+width <= nx)
+			found[g] = rect(g,x,y,x+width,y1);
+		else
+			found[g] = rect(g,x,y,nx,y1)+rect(g,0,y,x+width-nx,y1);
+		if (found[g] > 0)
+			worst = g;
+	}
+	return worst;
+}
+
+int BiopsyIndex::worst() const
+{
+	int worst = -1;
+	for (int g = 0; g < NUM_CELL_TYPES; g++)
+		if (sums[g][ny*(nx+1)+nx] > 0)
+			worst = g;
+	return worst;
+}
+
+Protocol::Protocol(Kind kind, int param, int width, int length, int depth):
+	kind(kind),
+	param(param),
+	width(width),
+	length(length),
+	depth(depth)
+{
+	assert(param > 0 && width > 0 && length > 0 && depth > 0);
+}
+
+Protocol* Protocol::jumbo(Kind kind, double param, const Parameters* p)
+{
+	double dx = p->cell_size();
+	int width = (5.0/dx)+0.5;
+	int length = (3.0/dx)+0.5;
+	int depth = (p->thickness()*(p->layer_fraction(EPITHELIUM)+
+		p->layer_fraction(BASEMENT_MEMBRANE)+p->layer_fraction(LAMINA_PROPIA))/dx)+0.5;
+	if (width < 1) width = 1;
+	if (length < 1) length = 1;
+	if (depth < 1) depth = 1;
+	// Spacing in cm or a number of biopsies
+	if (kind == SEATTLE)
+		param = param*10.0/dx+0.5;
+	if ((int)param < 1)
+		return NULL;
+	return new Protocol(kind,(int)param,width,length,depth);
+}
+
+bool Protocol::parse_kind(const char* name, Kind& kind)
+{
+	if (strcmp(name,"seattle") == 0) kind = SEATTLE;
+	else if (strcmp(name,"random") == 0) kind = RANDOM;
+	else return false;
+	return true;
+}
+
+int Protocol::examine(const BiopsyIndex& index, int be_length, Random* rng, int& taken) const
+{
+	const int nx = index.xdim();
+	int found[NUM_CELL_TYPES];
+	int worst = -1;
+	taken = 0;
+	if (be_length <= 0)
+		return worst;
+	// The biopsies must start inside the segment
+	int last = (be_length > length) ? be_length-length : 0;
+	if (kind == SEATTLE)
+	{
+		// A segment shorter than the spacing still gets one level
+		int first = rng->uniform_int((param <= last) ? param : last+1);
+		for (int y = first; y <= last; y += param)
+		{
+			int x0 = rng->uniform_int(nx);
+			for (int q = 0; q < 4; q++)
+			{
+				int g = index.sample(x0+(q*nx)/4,y,width,length,found);
+				if (g > worst) worst = g;
+				taken++;
+			}
+		}
+	}
+	else
+	{
+		for (; taken < param; taken++)
+		{
+			int g = index.sample(rng->uniform_int(nx),rng->uniform_int(last+1),
+				width,length,found);
+			if (g > worst) worst = g;
+		}
+	}
+	return worst;
+}
+
+double Protocol::sensitivity(const BiopsyIndex& index, int be_length, Random* rng,
+	int endoscopies, double detected[NUM_CELL_TYPES]) const
+{
+	int hits[NUM_CELL_TYPES] = { 0, 0, 0, 0 };
+	double biopsies = 0.0;
+	for (int n = 0; n < endoscopies; n++)
+	{
+		int taken;
+		int g = examine(index,be_length,rng,taken);
+		biopsies += taken;
+		for (int i = 0; i <= g; i++)
+			hits[i]++;
+	}
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		detected[i] = (endoscopies > 0) ? hits[i]/(double)endoscopies : 0.0;
+	return (endoscopies > 0) ? biopsies/endoscopies : 0.0;
+}
@@ -0,0 +1,136 @@
+#ifndef _biopsy_h_
+#define _biopsy_h_
+#include "common.h"
+#include "Census.h"
+#include "TissueGrid.h"
+#include <vector>
+
+/**
+ * Stream of a patient's seed that is used to place biopsies. It is
+ * separate from the streams used by the simulation, so taking biopsies
+ * does not change the course of the disease.
+ */
+#define BIOPSY_STREAM 0xFFFFFFFFUL
+
+/**
+ * A summary of the surface of the tissue that answers biopsy queries.
+ * A biopsy removes a rectangle of the surface to a fixed depth and the
+ * grade of each column of tissue under the surface is the most advanced
+ * type found in that depth. For every grade the index keeps a prefix
+ * sum over the surface of the columns with that grade, so a biopsy of
+ * any size costs O(1) once the index is built. Building it costs
+ * O(surface) plus O(cells that are not NORMAL). The x direction wraps
+ * around the circumference and biopsies are clipped to the ends of the
+ * space in the y direction.
+ */
+class BiopsyIndex
+{
+	public:
+		/**
+		 * Create an index for a surface of nx by ny cells and biopsies
+		 * that reach depth cells below it.
+		 */
+		BiopsyIndex(int nx, int ny, int depth);
+		/**
+		 * Set every column to NORMAL.
+		 */
+		void clear();
+		/**
+		 * Add a cell of the given type. Cells deeper than the biopsy
+		 * depth are ignored.
+		 */
+		void add(int x, int y, int z, int iType)
+		{
+			if (z < depth && iType > grade[y*nx+x])
+				grade[y*nx+x] = iType;
+		}
+		/**
+		 * Add the cells of a grid that are not NORMAL.
+		 */
+		void add(const TissueGrid& grid);
+		/**
+		 * Build the prefix sums after the cells have been added.
+		 */
+		void update();
+		/**
+		 * Count the columns of each grade in a biopsy that covers width
+		 * cells around the circumference starting at x and length cells
+		 * along the esophagus starting at y. Returns the most advanced
+		 * grade in the biopsy.
+		 */
+		int sample(int x, int y, int width, int length, int found[NUM_CELL_TYPES]) const;
+		/**
+		 * Most advanced grade of any column in the tissue.
+		 */
+		int worst() const;
+		int xdim() const { return nx; }
+		int ydim() const { return ny; }
+	private:
+		const int nx, ny, depth;
+		std::vector<unsigned char> grade; // Grade of each column
+		std::vector<int> sums[NUM_CELL_TYPES]; // Prefix sums of each grade
+		/// Columns of grade g in [x0,x1) by [y0,y1)
+		int rect(int g, int x0, int y0, int x1, int y1) const
+		{
+			const std::vector<int>& s = sums[g];
+			return s[y1*(nx+1)+x1]-s[y0*(nx+1)+x1]-s[y1*(nx+1)+x0]+s[y0*(nx+1)+x0];
+		}
+};
+
+/**
+ * A surveillance protocol. With the SEATTLE protocol, biopsies are taken
+ * from four quadrants at levels spaced evenly along the BE segment. The
+ * first level is placed at random within one spacing of the start of
+ * the segment, but always inside it, and the quadrants at each level
+ * are rotated at random.
+ * With the RANDOM protocol, a number of biopsies are placed uniformly
+ * over the BE segment. Every biopsy covers width by length cells and
+ * reaches depth cells below the surface.
+ */
+class Protocol
+{
+	public:
+		enum Kind { SEATTLE, RANDOM };
+		/**
+		 * Create a protocol. For SEATTLE, param is the spacing of the
+		 * levels in cells. For RANDOM, it is the number of biopsies.
+		 */
+		Protocol(Kind kind, int param, int width, int length, int depth);
+		/**
+		 * Create a protocol of jumbo biopsies for the grid in p. A
+		 * jumbo biopsy is 5 mm around the circumference and 3 mm along
+		 * the length, and it reaches through the lamina propia. For
+		 * SEATTLE, param is the spacing of the levels in cm. For RANDOM,
+		 * it is the number of biopsies. Returns NULL if the spacing is
+		 * less than a cell or there is less than one biopsy.
+		 */
+		static Protocol* jumbo(Kind kind, double param, const Parameters* p);
+		/**
+		 * Parse the name of a protocol. Returns false if the name is
+		 * not recognized.
+		 */
+		static bool parse_kind(const char* name, Kind& kind);
+		/**
+		 * Depth of a biopsy in cells. Use this to create the index.
+		 */
+		int biopsy_depth() const { return depth; }
+		/**
+		 * Perform one endoscopy on a patient whose BE segment is the
+		 * first be_length rows of the tissue. Return the most advanced
+		 * grade found by any biopsy and put the number of biopsies
+		 * taken into taken.
+		 */
+		int examine(const BiopsyIndex& index, int be_length, Random* rng, int& taken) const;
+		/**
+		 * Perform many endoscopies and put the fraction that found each
+		 * grade or a more advanced one into detected. Returns the mean
+		 * number of biopsies per endoscopy.
+		 */
+		double sensitivity(const BiopsyIndex& index, int be_length, Random* rng,
+			int endoscopies, double detected[NUM_CELL_TYPES]) const;
+	private:
+		const Kind kind;
+		const int param, width, length, depth;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _census_h_
+#define _census_h_
+#include "common.h"
+#include <vector>
+#include <unordered_map>
+
+/**
+ * The number of cells of each type in a grid and the set of cells that
+ * are not NORMAL. Every cell starts out NORMAL. The model reports each
+ * change of type as it happens, so counting the cells costs O(1) and
+ * listing the cells that are not NORMAL costs O(number of such cells)
+ * instead of a scan of the whole grid. Cells are identified by the
+ * index (y*nz+z)*nx+x used by the TissueGrid.
+ */
+class Census
+{
+	public:
+		Census(int nx, int ny, int nz):
+			nx(nx),ny(ny),nz(nz)
+		{
+			for (int i = 0; i < NUM_CELL_TYPES; i++)
+				counts[i] = 0;
+			counts[NORMAL] = nx*ny*nz;
+		}
+		/**
+		 * Record that a cell has changed from oldType to newType.
+		 */
+		void change(int cell, int oldType, int newType)
+		{
+			if (oldType == newType)
+				return;
+			counts[oldType]--;
+			counts[newType]++;
+			if (oldType == NORMAL)
+			{
+				pos[cell] = live.size();
+				live.push_back(cell);
+			}
+			else if (newType == NORMAL)
+			{
+				auto iter = pos.find(cell);
+				assert(iter != pos.end());
+				unsigned i = iter->second;
+				pos.erase(iter);
+				if (i != live.size()-1)
+				{
+					live[i] = live.back();
+					pos[live[i]] = i;
+				}
+				live.pop_back();
+			}
+		}
+		/**
+		 * Number of cells of the given type.
+		 */
+		int count(int iType) const { return counts[iType]; }
+		/**
+		 * Add the number of cells of each type to types.
+		 */
+		void add_counts(int types[NUM_CELL_TYPES]) const
+		{
+			for (int i = 0; i < NUM_CELL_TYPES; i++)
+				types[i] += counts[i];
+		}
+		/**
+		 * Cells that are not NORMAL in no particular order.
+		 */
+		const std::vector<int>& non_normal() const { return live; }
+		int index(int x, int y, int z) const { return (y*nz+z)*nx+x; }
+		/**
+		 * Get the position of a cell from its index.
+		 */
+		void position(int cell, int& x, int& y, int& z) const
+		{
+			x = cell%nx; z = (cell/nx)%nz; y = cell/(nx*nz);
+		}
+	private:
+		int nx, ny, nz; // Dimensions of the grid
+		int counts[NUM_CELL_TYPES]; // Number of cells of each type
+		std::vector<int> live; // Cells that are not NORMAL
+		std::unordered_map<int,unsigned> pos; // Position of each cell in live
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _checkpoint_h_
+#define _checkpoint_h_
+#include <iostream>
+#include <vector>
+
+/**
+ * Helpers for writing the state of the model to a binary checkpoint
+ * and reading it back. Values are stored in the byte order of the
+ * machine, so a checkpoint can only be restored on the same kind of
+ * machine that wrote it. A vector is stored as its size followed by
+ * its elements. The load functions return false if the stream ends
+ * early or has failed.
+ */
+template <class T> void save_value(std::ostream& out, const T& value)
+{
+	out.write((const char*)&value,sizeof(T));
+}
+
+template <class T> bool load_value(std::istream& in, T& value)
+{
+	in.read((char*)&value,sizeof(T));
+	return in.good();
+}
+
+template <class T> void save_vector(std::ostream& out, const std::vector<T>& v)
+{
+	save_value(out,(unsigned long)v.size());
+	if (!v.empty())
+		out.write((const char*)v.data(),v.size()*sizeof(T));
+}
+
+template <class T> bool load_vector(std::istream& in, std::vector<T>& v)
+{
+	unsigned long size;
+	if (!load_value(in,size))
+		return false;
+	v.resize(size);
+	if (size > 0)
+		in.read((char*)v.data(),size*sizeof(T));
+	return in.good();
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "Cohort.h"
+#include <vector>
+
+/**
+ * Write the counts and, if there is a protocol, the fractions of
+ * endoscopies that found dysplasia and cancer at one age.
+ */
+static void write_row(ofstream& fout, const int* counts, const double* detected,
+	const Protocol* protocol)
+{
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		fout << "," << counts[i];
+	if (protocol != NULL)
+		fout << "," << detected[DYSPLASIA] << "," << detected[CANCER];
+	fout << "\n";
+}
+
+void run_cohort(int patients, unsigned long first_seed,
+	const std::list<double>& biopsy, const char* filename,
+	bool aggregate, bool frontier, bool hybrid,
+	const Protocol* protocol, int endoscopies)
+{
+	const std::vector<double> ages(biopsy.begin(),biopsy.end());
+	// Rows of counts for each patient and the BE segment they had
+	std::vector<std::vector<int> > counts(patients);
+	std::vector<int> be_size(patients);
+	std::vector<double> be_onset(patients);
+	// Fraction of endoscopies that found each type
+	std::vector<std::vector<double> > detected(patients);
+	// Make sure the singleton exists before the threads use it
+	Parameters::getInstance();
+	#pragma omp parallel for schedule(dynamic,1)
+	for (int n = 0; n < patients; n++)
+	{
+		Patient patient(first_seed+n,aggregate,frontier,hybrid);
+		Random rng(first_seed+n,BIOPSY_STREAM);
+		be_size[n] = patient.be_length();
+		be_onset[n] = patient.be_onset();
+		counts[n].resize(ages.size()*NUM_CELL_TYPES);
+		detected[n].resize(ages.size()*NUM_CELL_TYPES);
+		follow_patient(patient,ages,&rng,protocol,endoscopies,
+			counts[n].data(),detected[n].data());
+	}
+	// Write the results in order of patient
+	ofstream fout(filename);
+	fout << "seed,be_length,be_onset,age,normal,BE,dysplasia,cancer";
+	if (protocol != NULL)
+		fout << ",detect_dysplasia,detect_cancer";
+	fout << endl;
+	double cm = Parameters::getInstance()->cell_size()/10.0;
+	for (int n = 0; n < patients; n++)
+	{
+		for (unsigned a = 0; a < ages.size(); a++)
+		{
+			fout << (first_seed+n) << "," << (be_size[n]*cm) << ","
+				<< be_onset[n] << "," << ages[a];
+			write_row(fout,&(counts[n][a*NUM_CELL_TYPES]),
+				&(detected[n][a*NUM_CELL_TYPES]),protocol);
+		}
+	}
+	fout.close();
+}
+
+void run_endpoints(int patients, unsigned long first_seed, double age,
+	const Endpoint& endpoint, const char* filename,
+	bool aggregate, bool frontier, bool hybrid)
+{
+	std::vector<Endpoint> end(patients,endpoint);
+	std::vector<int> be_size(patients);
+	std::vector<double> be_onset(patients);
+	std::vector<uint64_t> draws(patients);
+	Parameters::getInstance();
+	#pragma omp parallel for schedule(dynamic,1)
+	for (int n = 0; n < patients; n++)
+	{
+		Patient patient(first_seed+n,aggregate,frontier,hybrid);
+		be_size[n] = patient.be_length();
+		be_onset[n] = patient.be_onset();
+		patient.run_to(age,end[n]);
+		if (!end[n].reached())
+			end[n].age = age;
+		draws[n] = patient.draws();
+	}
+	ofstream fout(filename);
+	fout << "seed,be_length,be_onset,endpoint,age,draws" << endl;
+	double cm = Parameters::getInstance()->cell_size()/10.0;
+	for (int n = 0; n < patients; n++)
+		fout << (first_seed+n) << "," << (be_size[n]*cm) << "," << be_onset[n] <<
+			"," << end[n].name() << "," << end[n].age << "," << draws[n] << "\n";
+	fout.close();
+}
+
+void run_forks(const Patient& origin, double age, int forks,
+	const std::list<double>& biopsy, const char* filename,
+	const Protocol* protocol, int endoscopies)
+{
+	const std::vector<double> ages(biopsy.begin(),biopsy.end());
+	std::vector<std::vector<int> > counts(forks);
+	std::vector<std::vector<double> > detected(forks);
+	#pragma omp parallel for schedule(dynamic,1)
+	for (int n = 0; n < forks; n++)
+	{
+		Patient patient(origin,FORK_STREAM+n,age);
+		// Every fork sees the same biopsy locations
+		Random rng(origin.seed(),BIOPSY_STREAM);
+		counts[n].resize(ages.size()*NUM_CELL_TYPES);
+		detected[n].resize(ages.size()*NUM_CELL_TYPES);
+		follow_patient(patient,ages,&rng,protocol,endoscopies,
+			counts[n].data(),detected[n].data());
+	}
+	ofstream fout(filename);
+	fout << "fork,age,normal,BE,dysplasia,cancer";
+	if (protocol != NULL)
+		fout << ",detect_dysplasia,detect_cancer";
+	fout << endl;
+	for (int n = 0; n < forks; n++)
+	{
+		for (unsigned a = 0; a < ages.size(); a++)
+		{
+			fout << n << "," << ages[a];
+			write_row(fout,&(counts[n][a*NUM_CELL_TYPES]),
+				&(detected[n][a*NUM_CELL_TYPES]),protocol);
+		}
+	}
+	fout.close();
+}
@@ -0,0 +1,50 @@
+#ifndef _cohort_h_
+#define _cohort_h_
+#include <list>
+#include "Biopsy.h"
+#include "Patient.h"
+
+/**
+ * Simulate a cohort of patients in parallel and write the count of
+ * each cell type at every biopsy age to a CSV file with one row per
+ * patient and age. Patient n uses the random number seed first_seed+n
+ * and so has its own BE segment and onset age. Patients are handed to
+ * threads one at a time as threads become free because the time to
+ * simulate a patient varies by orders of magnitude. The aggregate,
+ * frontier and hybrid flags are passed to each Patient. If protocol is not NULL,
+ * then the given number of endoscopies are performed on each patient at
+ * every biopsy age and the fraction that found dysplasia and cancer is
+ * added to the row.
+ */
+void run_cohort(int patients, unsigned long first_seed,
+	const std::list<double>& biopsy, const char* filename,
+	bool aggregate, bool frontier, bool hybrid,
+	const Protocol* protocol = NULL, int endoscopies = 0);
+
+/**
+ * Simulate a cohort of patients in parallel, each only until it reaches
+ * the endpoint, has no events left or reaches the given age, and write
+ * one row per patient to a CSV file. The row has the reason the run
+ * ended, the age at which it did and the position of the patient's
+ * random numbers there. Patients are numbered and flagged as in
+ * run_cohort. With -hybrid most patients end at the birth of their first
+ * clone or at once if they will never have one.
+ */
+void run_endpoints(int patients, unsigned long first_seed, double age,
+	const Endpoint& endpoint, const char* filename,
+	bool aggregate, bool frontier, bool hybrid);
+
+/**
+ * Simulate many futures of a patient from the given age and write the
+ * counts at each biopsy age to a CSV file with one row per fork and
+ * age. Fork n is a copy of the patient that uses stream FORK_STREAM+n
+ * of its seed, so the forks share the history of the patient up to
+ * that age and then go their own ways. The forks are simulated in
+ * parallel. The protocol and endoscopies are used as in run_cohort,
+ * and every fork is examined with the same stream of biopsies.
+ */
+void run_forks(const Patient& origin, double age, int forks,
+	const std::list<double>& biopsy, const char* filename,
+	const Protocol* protocol = NULL, int endoscopies = 0);
+
+#endif
@@ -0,0 +1,273 @@
+#include "EventLog.h"
+#include <cstring>
+#include <zlib.h>
+#include <chrono>
+#include <cmath>
+
+EventLog::EventLog(const char* filename, double interval, bool compress,
+	size_t capacity):
+	fout(gzopen(filename,compress ? "wb" : "wbT")),
+	ring(capacity),
+	interval(interval),
+	origin(0.0),
+	next_count(interval),
+	last_age(0.0),
+	full(0),
+	secs(0.0),
+	done(false)
+{
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		counts[i] = 0;
+	if (fout == NULL)
+		return;
+	worker = std::thread(&EventLog::run,this);
+}
+
+EventLog::~EventLog()
+{
+	if (worker.joinable())
+		finish(last_age);
+}
+
+void EventLog::start(const TissueGrid& grid, double origin, double age)
+{
+	const Parameters* p = Parameters::getInstance();
+	char header[32];
+	int32_t dims[4] = { grid.xdim(), grid.ydim(), grid.zdim(), 0 };
+	double dx = p->cell_size();
+	memcpy(header,"ESOLOG01",8);
+	memcpy(header+8,dims,sizeof(dims));
+	memcpy(header+24,&dx,sizeof(double));
+	gzwrite(fout,header,sizeof(header));
+	this->origin = origin;
+	last_age = age;
+	// The first counts are at the first multiple of the interval
+	// after the start
+	next_count = interval*(floor(age/interval)+1.0);
+	const Census& census = grid.census();
+	const std::vector<int>& live = census.non_normal();
+	Entry e;
+	e.age = age;
+	e.kind = 'K';
+	e.v[0] = live.size();
+	put(e);
+	e.kind = 'k';
+	for (auto cell : live)
+	{
+		int x, y, z;
+		census.position(cell,x,y,z);
+		e.v[0] = cell;
+		e.v[1] = grid.itype(x,y,z);
+		put(e);
+	}
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		counts[i] = census.count(i);
+}
+
+void EventLog::changed(double t, int cell, int oldType, int newType)
+{
+	double age = origin+t;
+	// Counts before the change
+	put_counts(age,false);
+	Entry e;
+	e.age = age;
+	e.kind = 'C';
+	e.v[0] = cell;
+	e.v[1] = oldType;
+	e.v[2] = newType;
+	put(e);
+	counts[oldType]--;
+	counts[newType]++;
+	last_age = age;
+}
+
+void EventLog::finish(double age)
+{
+	if (!worker.joinable())
+		return;
+	put_counts(age,true);
+	done.store(true,std::memory_order_release);
+	worker.join();
+	gzclose(fout);
+	fout = NULL;
+}
+
+void EventLog::put(const Entry& e)
+{
+	if (ring.push(e))
+		return;
+	full++;
+	while (!ring.push(e))
+		std::this_thread::yield();
+}
+
+void EventLog::put_counts(double age, bool inclusive)
+{
+	while (next_count < age || (inclusive && next_count == age))
+	{
+		Entry e;
+		e.age = next_count;
+		e.kind = 'N';
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			e.v[i] = counts[i];
+		put(e);
+		next_count += interval;
+	}
+}
+
+void EventLog::run()
+{
+	Entry e;
+	for (;;)
+	{
+		if (!ring.pop(e))
+		{
+			// Everything put before done was set can be taken now
+			if (done.load(std::memory_order_acquire))
+			{
+				while (ring.pop(e))
+					write(e);
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			continue;
+		}
+		// Write until the buffer is empty
+		auto start = std::chrono::steady_clock::now();
+		do write(e); while (ring.pop(e));
+		secs += std::chrono::duration<double>(
+			std::chrono::steady_clock::now()-start).count();
+	}
+}
+
+void EventLog::write(const Entry& e)
+{
+	char buf[1+sizeof(double)+sizeof(e.v)];
+	int n = 0;
+	// Cells of a keyframe follow its count without a tag or age
+	if (e.kind == 'k')
+	{
+		uint32_t cell = e.v[0];
+		uint8_t type = e.v[1];
+		memcpy(buf,&cell,4);
+		buf[4] = type;
+		gzwrite(fout,buf,5);
+		return;
+	}
+	buf[n++] = e.kind;
+	memcpy(buf+n,&e.age,sizeof(double));
+	n += sizeof(double);
+	if (e.kind == 'C')
+	{
+		uint32_t cell = e.v[0];
+		memcpy(buf+n,&cell,4);
+		buf[n+4] = (char)((e.v[1] << 4) | e.v[2]);
+		n += 5;
+	}
+	else
+	{
+		int values = (e.kind == 'K') ? 1 : NUM_CELL_TYPES;
+		memcpy(buf+n,e.v,4*values);
+		n += 4*values;
+	}
+	gzwrite(fout,buf,n);
+}
+
+EventLogReader::EventLogReader(const char* filename):
+	fin(gzopen(filename,"rb")),
+	ok(false),
+	dx(0.0),
+	tag(0),
+	next_age(0.0)
+{
+	char header[32];
+	if (fin == NULL || gzread(fin,header,sizeof(header)) != (int)sizeof(header) ||
+		memcmp(header,"ESOLOG01",8) != 0)
+		return;
+	memcpy(dims,header+8,sizeof(dims));
+	memcpy(&dx,header+24,sizeof(double));
+	cells.assign((size_t)dims[0]*dims[1]*dims[2],NORMAL);
+	ok = true;
+	peek();
+}
+
+EventLogReader::~EventLogReader()
+{
+	if (fin != NULL)
+		gzclose(fin);
+}
+
+void EventLogReader::peek()
+{
+	if (gzread(fin,&tag,1) != 1 ||
+		gzread(fin,&next_age,sizeof(double)) != (int)sizeof(double))
+		tag = 0;
+}
+
+void EventLogReader::apply()
+{
+	if (tag == 'C')
+	{
+		uint32_t cell;
+		uint8_t types;
+		if (gzread(fin,&cell,4) != 4 || gzread(fin,&types,1) != 1 ||
+			cell >= cells.size())
+		{
+			tag = 0;
+			return;
+		}
+		cells[cell] = types & 0x0F;
+	}
+	else if (tag == 'N')
+	{
+		Counts c;
+		c.age = next_age;
+		if (gzread(fin,c.types,sizeof(c.types)) != (int)sizeof(c.types))
+		{
+			tag = 0;
+			return;
+		}
+		logged.push_back(c);
+	}
+	else if (tag == 'K')
+	{
+		uint32_t n;
+		if (gzread(fin,&n,4) != 4)
+		{
+			tag = 0;
+			return;
+		}
+		cells.assign(cells.size(),NORMAL);
+		for (uint32_t i = 0; i < n; i++)
+		{
+			uint32_t cell;
+			uint8_t type;
+			if (gzread(fin,&cell,4) != 4 || gzread(fin,&type,1) != 1 ||
+				cell >= cells.size())
+			{
+				tag = 0;
+				return;
+			}
+			cells[cell] = type;
+		}
+	}
+	else
+	{
+		tag = 0;
+		return;
+	}
+	peek();
+}
+
+Snapshot* EventLogReader::frame(int seq_num, double age)
+{
+	const int nx = dims[0], ny = dims[1], nz = dims[2];
+	while (tag != 0 && next_age <= age)
+		apply();
+	Snapshot* s = new Snapshot(seq_num,age,nx,ny,nz,dx);
+	for (int y = 0; y < ny; y++)
+		for (int z = 0; z < nz; z++)
+			for (int x = 0; x < nx; x++)
+				s->at(x,y,z) = cells[(y*nz+z)*nx+x];
+	return s;
+}
@@ -0,0 +1,164 @@
+#ifndef _event_log_h_
+#define _event_log_h_
+#include "TissueGrid.h"
+#include "RingBuffer.h"
+#include "Snapshot.h"
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// The file handle of zlib, which is not included here because it would
+// hide names such as compress
+struct gzFile_s;
+
+/**
+ * Records every change of type in a TissueGrid, and the count of each
+ * type at every multiple of an interval of age, to a binary log. The
+ * simulation only puts records into a lock-free RingBuffer. A thread of
+ * the log takes them out and writes them, so the event loop never waits
+ * for the disk. If the buffer fills, the simulation spins until the
+ * writer makes room, and these stalls are counted. The log is written
+ * with zlib, compressed or not, and begins with a 32 byte header: the
+ * characters ESOLOG01, the int32 values nx, ny, nz and 0, and the
+ * float64 cell size in mm. Each record after it is a tag and a float64
+ * age:
+ *
+ * K: a keyframe. A uint32 count n and n pairs of a uint32 cell and a
+ *	uint8 type. Every cell that is not listed is NORMAL.
+ * C: a change of type. A uint32 cell and a uint8 with the old type in
+ *	the high four bits and the new type in the low four bits.
+ * N: the count of each type as NUM_CELL_TYPES int32 values.
+ *
+ * Cells are numbered (y*nz+z)*nx+x as in the TissueGrid. Ages are in
+ * increasing order and all values are little endian. A count at age A
+ * includes every change at or before A.
+ */
+class EventLog: public CellObserver
+{
+	public:
+		/**
+		 * Create a log file with the given name. Counts are written
+		 * every interval years. The file is compressed if the flag is
+		 * set. The buffer holds capacity records.
+		 */
+		EventLog(const char* filename, double interval, bool compress,
+			size_t capacity = 65536);
+		/**
+		 * Was the file opened?
+		 */
+		bool good() const { return fout != NULL; }
+		/**
+		 * Start logging a grid, whose time zero is the given origin,
+		 * with a keyframe of its cells at the given age. The age is
+		 * later than the origin if the grid has run, as it has when
+		 * restored from a checkpoint. Attach the log to the grid with
+		 * TissueGrid::observe to get its changes.
+		 */
+		void start(const TissueGrid& grid, double origin, double age);
+		/**
+		 * Queue the change of a cell at time t of the grid.
+		 */
+		void changed(double t, int cell, int oldType, int newType);
+		/**
+		 * Queue the counts up to the given age, write every record and
+		 * close the file. Nothing can be logged after this.
+		 */
+		void finish(double age);
+		/**
+		 * Number of times the simulation found the buffer full.
+		 */
+		unsigned long stalls() const { return full; }
+		/**
+		 * Seconds the writer spent writing. Call finish() first.
+		 */
+		double write_seconds() const { return secs; }
+		/**
+		 * Finishes at the age of the last record.
+		 */
+		~EventLog();
+	private:
+		EventLog(const EventLog&);
+		EventLog& operator=(const EventLog&);
+		/// A record in the buffer. Changes put the cell, old type and
+		/// new type into v, counts put the count of each type, a
+		/// keyframe puts the number of cells and each cell of it puts
+		/// the cell and its type.
+		struct Entry
+		{
+			double age;
+			int32_t v[NUM_CELL_TYPES];
+			char kind;
+		};
+		gzFile_s* fout; // The log
+		RingBuffer<Entry> ring; // Records waiting to be written
+		double interval; // Years between counts
+		double origin; // Age at time zero of the grid
+		double next_count; // Age of the next counts
+		double last_age; // Age of the last record
+		int counts[NUM_CELL_TYPES]; // Current count of each type
+		unsigned long full; // Times the buffer was full
+		double secs; // Seconds spent writing
+		std::atomic<bool> done; // Is the simulation finished?
+		std::thread worker;
+		/// Put a record into the buffer, waiting for room if it is full
+		void put(const Entry& e);
+		/// Queue the counts at every multiple of the interval before age
+		/// or, if the flag is set, at age too
+		void put_counts(double age, bool inclusive);
+		/// Take records out of the buffer and write them until done
+		void run();
+		void write(const Entry& e);
+};
+
+/**
+ * Rebuilds the grid at any age from a log written by an EventLog. The
+ * keyframe and changes are applied in order, so the frames must be
+ * requested at ages that do not decrease.
+ */
+class EventLogReader
+{
+	public:
+		/// Count of each type at one age
+		struct Counts
+		{
+			double age;
+			int types[NUM_CELL_TYPES];
+		};
+		/**
+		 * Open a log and read its header.
+		 */
+		EventLogReader(const char* filename);
+		/**
+		 * Was the header read?
+		 */
+		bool good() const { return ok; }
+		/**
+		 * Apply every record at or before the given age and return a
+		 * snapshot of the grid with that age and number. The caller
+		 * must delete it.
+		 */
+		Snapshot* frame(int seq_num, double age);
+		/**
+		 * Counts read from the log so far.
+		 */
+		const std::vector<Counts>& counts() const { return logged; }
+		~EventLogReader();
+	private:
+		EventLogReader(const EventLogReader&);
+		EventLogReader& operator=(const EventLogReader&);
+		gzFile_s* fin; // The log
+		bool ok; // Was the header read?
+		int32_t dims[4]; // nx, ny, nz and 0
+		double dx; // Size of a cell in mm
+		std::vector<unsigned char> cells; // Types in the order of the log
+		std::vector<Counts> logged; // Counts read so far
+		char tag; // Tag of the next record or 0 at the end of the log
+		double next_age; // Age of the next record
+		/// Read the tag and age of the next record
+		void peek();
+		/// Read the body of the next record and apply it
+		void apply();
+};
+
+#endif
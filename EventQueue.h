@@ -0,0 +1,131 @@
+#ifndef _event_queue_h_
+#define _event_queue_h_
+#include <vector>
+#include <unordered_map>
+#include <cassert>
+#include <cstddef>
+
+/**
+ * Indexed binary heap of cells that have a pending event. Every cell
+ * carries two clocks, the absolute time at which it will mutate and the
+ * absolute time at which it will expand, and the cell is ordered by the
+ * earlier of the two. A cell appears at most once and its clocks can be
+ * reset in place in O(log n), which is what happens when a cell is
+ * invaded by a neighbor.
+ */
+class EventQueue
+{
+	public:
+		/// A cell and its clocks
+		struct Entry
+		{
+			double tm, te; // Absolute time to mutate and expand
+			int cell; // Index of the cell in the grid
+			double t() const { return (tm < te) ? tm : te; }
+		};
+		EventQueue(){}
+		bool empty() const { return heap.empty(); }
+		unsigned size() const { return heap.size(); }
+		/**
+		 * Get the cell with the earliest event. The queue must not be empty.
+		 */
+		const Entry& top() const { return heap[0]; }
+		/**
+		 * Get the clocks for a cell or NULL if it is not in the queue.
+		 */
+		const Entry* find(int cell) const
+		{
+			auto iter = pos.find(cell);
+			return (iter == pos.end()) ? NULL : &(heap[iter->second]);
+		}
+		/**
+		 * Insert a cell or reset the clocks of a cell already in the queue.
+		 */
+		void set(int cell, double tm, double te)
+		{
+			auto iter = pos.find(cell);
+			if (iter == pos.end())
+			{
+				Entry e;
+				e.tm = tm; e.te = te; e.cell = cell;
+				heap.push_back(e);
+				pos[cell] = heap.size()-1;
+				sift_up(heap.size()-1);
+			}
+			else
+			{
+				unsigned i = iter->second;
+				double old_t = heap[i].t();
+				heap[i].tm = tm; heap[i].te = te;
+				if (heap[i].t() < old_t) sift_up(i);
+				else sift_down(i);
+			}
+		}
+		/**
+		 * Remove a cell from the queue if it is there.
+		 */
+		void remove(int cell)
+		{
+			auto iter = pos.find(cell);
+			if (iter == pos.end())
+				return;
+			unsigned i = iter->second;
+			pos.erase(iter);
+			if (i == heap.size()-1)
+			{
+				heap.pop_back();
+				return;
+			}
+			double old_t = heap[i].t();
+			heap[i] = heap.back();
+			heap.pop_back();
+			pos[heap[i].cell] = i;
+			if (heap[i].t() < old_t) sift_up(i);
+			else sift_down(i);
+		}
+		void clear() { heap.clear(); pos.clear(); }
+		/**
+		 * Every entry in the order of the heap. Inserting them into an
+		 * empty queue in this order rebuilds the same heap.
+		 */
+		const std::vector<Entry>& entries() const { return heap; }
+	private:
+		std::vector<Entry> heap; // Binary heap ordered by Entry::t()
+		std::unordered_map<int,unsigned> pos; // Position of each cell in the heap
+		void swap(unsigned i, unsigned j)
+		{
+			Entry tmp = heap[i];
+			heap[i] = heap[j];
+			heap[j] = tmp;
+			pos[heap[i].cell] = i;
+			pos[heap[j].cell] = j;
+		}
+		void sift_up(unsigned i)
+		{
+			while (i > 0)
+			{
+				unsigned parent = (i-1)/2;
+				if (!(heap[i].t() < heap[parent].t()))
+					break;
+				swap(i,parent);
+				i = parent;
+			}
+		}
+		void sift_down(unsigned i)
+		{
+			for (;;)
+			{
+				unsigned left = 2*i+1, right = left+1, least = i;
+				if (left < heap.size() && heap[left].t() < heap[least].t())
+					least = left;
+				if (right < heap.size() && heap[right].t() < heap[least].t())
+					least = right;
+				if (least == i)
+					break;
+				swap(i,least);
+				i = least;
+			}
+		}
+};
+
+#endif
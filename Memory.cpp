@@ -0,0 +1,63 @@
+#include "Memory.h"
+#include "TissueVolume.h"
+#include "EventQueue.h"
+#include "Biopsy.h"
+#include "TissueGrid.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+using namespace std;
+
+// Bytes for a node of an unordered_map<int,unsigned> and its bucket
+static const double map_entry = 2*sizeof(void*)+2*sizeof(int)+sizeof(void*);
+
+MemoryEstimate estimate_memory(Engine engine, int nx, int ny, int nz,
+	int copies, int snapshots)
+{
+	MemoryEstimate m;
+	m.voxels = (double)nx*ny*nz;
+	const double surface = (double)nx*ny;
+	// Each active cell has a heap entry and a position in the queue and
+	// each cell that is not NORMAL has a place in the census
+	const double active = sizeof(EventQueue::Entry)+map_entry+sizeof(int)+map_entry;
+	double dense;
+	if (engine == ADEVS_ENGINE)
+		// The volume, its pointer in the CellSpace, and its place in
+		// the schedule of the simulator
+		dense = sizeof(TissueVolume)+2*sizeof(void*);
+	else
+		dense = 1.0;
+	m.bytes_per_voxel = dense+active*surface/m.voxels;
+	// The parts record every event of a window so it can be rolled
+	// back. A window starts at the mean time between expansions, so
+	// there are about as many events in it as there are active cells.
+	if (engine == PARALLEL_ENGINE)
+		m.bytes_per_voxel += TissueGrid::recorded_bytes_per_event()*surface/m.voxels;
+	// The biopsy index holds a grade and a prefix sum for each type
+	double index = surface*(1.0+NUM_CELL_TYPES*sizeof(int));
+	m.peak = copies*(m.bytes_per_voxel*m.voxels+index)+snapshots*m.voxels;
+	return m;
+}
+
+void print_estimate(const char* engine, const MemoryEstimate& m)
+{
+	cout << "engine : " << engine << endl;
+	cout << "voxels : " << m.voxels << endl;
+	cout << "bytes/voxel : " << m.bytes_per_voxel << endl;
+	cout << "peak MB : " << m.peak/1048576.0 << endl;
+}
+
+void process_memory(long& rss_kb, long& peak_kb)
+{
+	rss_kb = peak_kb = 0;
+	ifstream fin("/proc/self/status");
+	for (string line; getline(fin,line); )
+	{
+		istringstream sin(line);
+		string name;
+		sin >> name;
+		if (name == "VmRSS:") sin >> rss_kb;
+		else if (name == "VmHWM:") sin >> peak_kb;
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef _memory_h_
+#define _memory_h_
+
+/**
+ * The ways that a tissue can be simulated.
+ */
+enum Engine { ADEVS_ENGINE, GRID_ENGINE, PARALLEL_ENGINE };
+
+/**
+ * An estimate of the memory needed to simulate a tissue. The dense part
+ * is a fixed number of bytes for every grid point. Cells with a pending
+ * event and cells that are not NORMAL cost more, and the estimate
+ * assumes there are about as many of these as there are points on the
+ * surface. This is true until cancer has spread through much of the
+ * wall. The parallel engine also records each event of a window so it
+ * can be rolled back. Snapshots hold one byte for every grid point.
+ */
+struct MemoryEstimate
+{
+	double voxels; // Grid points in one tissue
+	double bytes_per_voxel; // Bytes for each grid point of one tissue
+	double peak; // Bytes for the whole run
+};
+
+/**
+ * Estimate the memory for a run with the given engine and grid. Copies
+ * is the number of tissues simulated at once, as in a cohort, and
+ * snapshots is the number of snapshots held at once.
+ */
+MemoryEstimate estimate_memory(Engine engine, int nx, int ny, int nz,
+	int copies, int snapshots);
+
+/**
+ * Print an estimate in a form that people can read.
+ */
+void print_estimate(const char* engine, const MemoryEstimate& m);
+
+/**
+ * Resident and peak resident memory of the process in kB, or zero if
+ * they cannot be read.
+ */
+void process_memory(long& rss_kb, long& peak_kb);
+
+#endif
@@ -0,0 +1,179 @@
+#include "ParallelTissue.h"
+#include <algorithm>
+
+ParallelTissue::ParallelTissue(int sectors, int slabs, unsigned long seed, bool aggregate):
+	sectors(sectors),
+	slabs(slabs),
+	rollback_count(0),
+	window_count(0),
+	replay_count(0)
+{
+	Parameters* p = Parameters::getInstance();
+	assert(sectors > 0 && sectors <= p->xdim());
+	assert(slabs > 0 && slabs <= p->ydim());
+	// Divide each direction as evenly as we can
+	for (int i = 0; i <= sectors; i++)
+		x_first.push_back((i*p->xdim())/sectors);
+	for (int j = 0; j <= slabs; j++)
+		y_first.push_back((j*p->ydim())/slabs);
+	for (int i = 0; i < sectors; i++)
+		for (int x = x_first[i]; x < x_first[i+1]; x++)
+			x_part.push_back(i);
+	for (int j = 0; j < slabs; j++)
+		for (int y = y_first[j]; y < y_first[j+1]; y++)
+			y_part.push_back(j);
+	for (int j = 0; j < slabs; j++)
+	{
+		for (int i = 0; i < sectors; i++)
+		{
+			Part* part = new Part();
+			part->rng.set_seed(seed,parts.size()+1);
+			part->rng.pool(p->pooled_random());
+			part->grid = new TissueGrid(x_first[i+1]-x_first[i],
+				y_first[j+1]-y_first[j],p->zdim(),&(part->rng),
+				x_first[i],y_first[j]);
+			part->grid->aggregate_be(aggregate);
+			part->events = part->replays = 0;
+			part->dirty = false;
+			part->t_changed = 0.0;
+			parts.push_back(part);
+		}
+	}
+	// Expansions happen at this rate in each cell, so a window of this
+	// size sees about one crossing per cell on the edge of a clone.
+	window = p->get_expand_interval();
+}
+
+ParallelTissue::~ParallelTissue()
+{
+	for (auto part : parts)
+	{
+		delete part->grid;
+		delete part;
+	}
+}
+
+void ParallelTissue::add(int iType, int x, int y, int z)
+{
+	Part* owner = part(x,y);
+	owner->grid->add(iType,x-x_first[x_part[x]],y-y_first[y_part[y]],z);
+}
+
+int ParallelTissue::itype(int x, int y, int z) const
+{
+	const Part* owner = part(x,y);
+	return owner->grid->itype(x-x_first[x_part[x]],y-y_first[y_part[y]],z);
+}
+
+double ParallelTissue::nextEventTime() const
+{
+	double t = adevs_inf<double>();
+	for (auto part : parts)
+	{
+		double tn = part->grid->nextEventTime();
+		if (tn < t) t = tn;
+	}
+	return t;
+}
+
+unsigned long ParallelTissue::execUntil(double tstop)
+{
+	unsigned long count = 0;
+	// Only one part, so there is nothing to exchange
+	if (parts.size() == 1)
+		return parts[0]->grid->execUntil(tstop);
+	for (double t = nextEventTime(); t <= tstop; t = nextEventTime())
+	{
+		double tend = (window < tstop-t) ? t+window : tstop;
+		count += execWindow(tend);
+	}
+	return count;
+}
+
+/**
+ * Sort the new expansions into a part and return the time of the first
+ * one that differs from the old expansions or infinity if they are the
+ * same.
+ */
+static double first_change(const std::vector<TissueGrid::Expansion>& old_xb,
+	std::vector<TissueGrid::Expansion>& new_xb)
+{
+	std::sort(new_xb.begin(),new_xb.end());
+	unsigned i = 0;
+	while (i < old_xb.size() && i < new_xb.size() && old_xb[i] == new_xb[i])
+		i++;
+	double t = adevs_inf<double>();
+	if (i < old_xb.size())
+		t = old_xb[i].t;
+	if (i < new_xb.size() && new_xb[i].t < t)
+		t = new_xb[i].t;
+	return t;
+}
+
+unsigned long ParallelTissue::execWindow(double tend)
+{
+	const int num_parts = parts.size();
+	window_count++;
+	// Record the changes from the start of the window
+	for (auto part : parts)
+	{
+		part->grid->mark();
+		part->inbox.clear();
+		part->events = part->replays = 0;
+		part->dirty = true;
+		part->t_changed = 0.0;
+	}
+	int repeats = 0;
+	for (;;)
+	{
+		// Simulate every part that has new expansions
+		#pragma omp parallel for schedule(dynamic,1)
+		for (int n = 0; n < num_parts; n++)
+		{
+			Part* part = parts[n];
+			if (!part->dirty)
+				continue;
+			// Undo the events from the first expansion that changed.
+			// The grid replays the same random numbers from there.
+			unsigned long undone = part->grid->rollback(part->t_changed,part->inbox);
+			part->events -= undone;
+			part->replays += undone;
+			part->events += part->grid->execUntil(tend);
+		}
+		// Gather the expansions that cross into each part
+		std::vector<std::vector<TissueGrid::Expansion> > inbox(num_parts);
+		for (auto part : parts)
+			for (auto xb : part->grid->outgoing())
+				inbox[y_part[xb.y]*sectors+x_part[xb.x]].push_back(xb);
+		// Any part whose inputs changed must be simulated again
+		bool done = true;
+		for (int n = 0; n < num_parts; n++)
+		{
+			parts[n]->t_changed = first_change(parts[n]->inbox,inbox[n]);
+			parts[n]->dirty = (parts[n]->t_changed < adevs_inf<double>());
+			if (parts[n]->dirty)
+			{
+				parts[n]->inbox.swap(inbox[n]);
+				rollback_count++;
+				done = false;
+			}
+		}
+		if (done)
+			break;
+		repeats++;
+	}
+	// Grow or shrink the window to keep the number of repeats small
+	if (repeats == 0)
+		window *= 2.0;
+	else if (repeats > 2)
+		window /= 2.0;
+	unsigned long count = 0;
+	for (auto part : parts)
+	{
+		part->grid->clear_outgoing();
+		part->grid->incoming(std::vector<TissueGrid::Expansion>());
+		count += part->events;
+		replay_count += part->replays;
+	}
+	return count;
+}
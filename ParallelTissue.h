@@ -0,0 +1,99 @@
+#ifndef _parallel_tissue_h_
+#define _parallel_tissue_h_
+#include "TissueGrid.h"
+#include <vector>
+
+/**
+ * A single tissue simulated in parallel by dividing the space into
+ * slabs along its length (y) and sectors around its circumference (x).
+ * Each part is a TissueGrid with its own stream of random numbers.
+ * Expansions that cross from one part to another are exchanged in
+ * windows of simulated time. Every part simulates the window using the
+ * expansions it knows about. Then any part that received new or changed
+ * expansions from its neighbors is rolled back to the time of the first
+ * one that changed and simulated again from there. This repeats until
+ * the expansions stop changing. Because a part replays the same random
+ * numbers when it is rolled back, the result is a valid run of the
+ * sequential model. It is also the same for any number of threads. The
+ * parts record the cells that change instead of copying themselves at
+ * the start of a window, so a window costs about as much as the events
+ * in it. The window is sized to keep the number of repeats small. The
+ * frontier option of the TissueGrid cannot be used because it needs the
+ * cells of neighboring parts.
+ */
+class ParallelTissue
+{
+	public:
+		/**
+		 * Create a tissue of NORMAL cells with the dimensions in the
+		 * Parameters object, split into the given number of sectors
+		 * and slabs. Part n uses stream n+1 of the seed. The aggregate
+		 * flag is passed to TissueGrid::aggregate_be.
+		 */
+		ParallelTissue(int sectors, int slabs, unsigned long seed, bool aggregate);
+		/**
+		 * Set the initial type of a cell.
+		 */
+		void add(int iType, int x, int y, int z);
+		/**
+		 * Get the type of the cell at x, y, z.
+		 */
+		int itype(int x, int y, int z) const;
+		/**
+		 * Number of parts in the space.
+		 */
+		int num_parts() const { return parts.size(); }
+		/**
+		 * Get the cells of the nth part.
+		 */
+		const TissueGrid& part_grid(int n) const { return *(parts[n]->grid); }
+		/**
+		 * Absolute time of the next event or infinity if there is none.
+		 */
+		double nextEventTime() const;
+		/**
+		 * Execute every event with a time less than or equal to tstop
+		 * and return the number of events that were executed.
+		 */
+		unsigned long execUntil(double tstop);
+		/**
+		 * Number of times that a part was rolled back and simulated
+		 * again.
+		 */
+		unsigned long rollbacks() const { return rollback_count; }
+		/**
+		 * Number of events that were undone by rollbacks and simulated
+		 * again.
+		 */
+		unsigned long replays() const { return replay_count; }
+		/**
+		 * Number of windows that have been simulated.
+		 */
+		unsigned long windows() const { return window_count; }
+		~ParallelTissue();
+	private:
+		ParallelTissue(const ParallelTissue&){}
+		ParallelTissue& operator=(const ParallelTissue&) { return *this; }
+		/// One part of the space
+		struct Part
+		{
+			Random rng; // Random numbers for this part
+			TissueGrid* grid; // Cells in this part
+			std::vector<TissueGrid::Expansion> inbox; // Expansions into this part
+			unsigned long events; // Events in the current window
+			unsigned long replays; // Events undone in the current window
+			bool dirty; // Must the window be simulated again?
+			double t_changed; // Time of the first expansion that changed
+		};
+		std::vector<Part*> parts;
+		std::vector<int> x_part, y_part; // Sector and slab of each x and y
+		std::vector<int> x_first, y_first; // First x and y of each sector and slab
+		int sectors, slabs;
+		double window; // Size of the next window
+		unsigned long rollback_count, window_count, replay_count;
+		Part* part(int x, int y) const { return parts[y_part[y]*sectors+x_part[x]]; }
+		/// Simulate one window that ends at tend
+		unsigned long execWindow(double tend);
+};
+
+#endif
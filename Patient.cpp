@@ -0,0 +1,262 @@
+#include "Patient.h"
+#include "Checkpoint.h"
+#include <cmath>
+
+int calculate_be_length(Random* rng)
+{
+	const double long_be_prob = 0.63;
+	const double long_be_mean = 6.4; // cm
+	const double long_be_std_dev = 3.1; // cm
+	const double short_be_mean = 1.4; // cm
+	const double short_be_std_dev = 0.7; // cm
+	double length; 
+	if (rng->uniform() < long_be_prob)
+		length = rng->normal(long_be_mean,long_be_std_dev);
+	else
+		length = rng->normal(short_be_mean,short_be_std_dev);
+	if (length < 0.0) length = 0.0;
+	return (int(length*10.0/Parameters::getInstance()->cell_size())+1);
+}
+
+// Rows of NORMAL tissue kept past the last DYSPLASIA or CANCER cell
+static const int roi_margin = 16;
+
+Patient::Patient(unsigned long seed, bool aggregate, bool frontier, bool hybrid):
+	ranseed(seed),
+	rng(seed),
+	aggregate(aggregate),
+	frontier(frontier),
+	t_clone(0.0),
+	clone_cell(-1),
+	grid(NULL)
+{
+	Parameters* p = Parameters::getInstance();
+	rng.pool(p->pooled_random());
+	be_size = calculate_be_length(&rng);
+	// Draw the birth and position of the first clone instead of the
+	// clocks of every BE cell
+	if (hybrid && p->get_mutation_interval(NORMAL) == adevs_inf<double>())
+	{
+		int cells = be_cells();
+		double interval = p->get_mutation_interval(BE);
+		if (cells == 0 || interval == adevs_inf<double>())
+			t_clone = adevs_inf<double>();
+		else
+		{
+			t_clone = rng.exponential(interval/cells);
+			clone_cell = rng.uniform_int(cells);
+		}
+	}
+	else build();
+	// Get the BE onset age
+	onset = rng.exponential(p->be_onset_age());
+}
+
+int Patient::be_cells() const
+{
+	const Parameters* p = Parameters::getInstance();
+	return p->xdim()*((be_size < p->ydim()) ? be_size : p->ydim());
+}
+
+void Patient::build()
+{
+	Parameters* p = Parameters::getInstance();
+	int ni = p->xdim(), nj = p->ydim(), nk = p->zdim();
+	grid = new TissueGrid(ni,nj,nk,&rng);
+	grid->aggregate_be(aggregate);
+	grid->frontier_only(frontier);
+	// Top layer has BE, everything else is initially normal. Normal
+	// cells only need to be added if they can do something. If they
+	// cannot, then only the BE segment and a margin are stored.
+	bool normal_fires = p->get_mutation_interval(NORMAL) < adevs_inf<double>();
+	if (!normal_fires)
+	{
+		grid->region_of_interest(roi_margin);
+		nj = (be_size < nj) ? be_size : nj;
+	}
+	for (int i = 0; i < ni; i++)
+	{
+		for (int j = 0; j < nj; j++)
+		{
+			for (int k = 0; k < nk; k++)
+			{
+				if (k == 0 && j*ni+i == clone_cell)
+					grid->add(ModelRules::mutates_to(BE),i,j,k);
+				else if (k == 0 && j < be_size)
+					grid->add(BE,i,j,k);
+				else if (normal_fires)
+					grid->add(NORMAL,i,j,k);
+			}
+		}
+	}
+}
+
+Patient::Patient(const Patient& origin, unsigned long stream, double age):
+	ranseed(origin.ranseed),
+	rng(origin.ranseed,stream),
+	be_size(origin.be_size),
+	onset(origin.onset),
+	aggregate(origin.aggregate),
+	frontier(origin.frontier),
+	t_clone(origin.t_clone),
+	clone_cell(origin.clone_cell),
+	grid(new TissueGrid(*(origin.grid)))
+{
+	rng.pool(origin.rng.pooled());
+	grid->random(&rng);
+	grid->observe(NULL);
+	grid->redraw((age > clone_age()) ? age-clone_age() : 0.0);
+}
+
+Patient* Patient::restore(std::istream& in)
+{
+	Parameters* p = Parameters::getInstance();
+	Patient* patient = new Patient();
+	patient->grid = new TissueGrid(p->xdim(),p->ydim(),p->zdim(),&(patient->rng));
+	if (!load_value(in,patient->ranseed) || !load_value(in,patient->be_size) ||
+		!load_value(in,patient->onset) || !load_value(in,patient->t_clone) ||
+		!load_value(in,patient->clone_cell) || !patient->rng.load(in) ||
+		!patient->grid->load(in))
+	{
+		delete patient;
+		return NULL;
+	}
+	return patient;
+}
+
+void Patient::save(std::ostream& out) const
+{
+	assert(grid != NULL);
+	save_value(out,ranseed);
+	save_value(out,be_size);
+	save_value(out,onset);
+	save_value(out,t_clone);
+	save_value(out,clone_cell);
+	rng.save(out);
+	grid->save(out);
+}
+
+Patient::~Patient()
+{
+	delete grid;
+}
+
+unsigned long Patient::run_to(double age)
+{
+	unsigned long events = 0;
+	// Nothing happens before the first clone is born
+	if (grid == NULL)
+	{
+		if (age < clone_age())
+			return 0;
+		build();
+		events++;
+	}
+	return events+grid->execUntil(age-clone_age());
+}
+
+const char* Endpoint::name() const
+{
+	switch (reason)
+	{
+		case FIRST_CELL: return (type == CANCER) ? "cancer" : "dysplasia";
+		case VOLUME: return "volume";
+		case NO_EVENTS: return "no_events";
+		default: return "none";
+	}
+}
+
+unsigned long Patient::run_to(double age, Endpoint& end)
+{
+	const Parameters* p = Parameters::getInstance();
+	const double cell_volume = pow(p->cell_size(),3.0);
+	int types[NUM_CELL_TYPES];
+	unsigned long events = 0;
+	// Age of the last event, which is the onset if there were none
+	double last = onset;
+	for (;;)
+	{
+		double t = next_event();
+		if (t == adevs_inf<double>())
+		{
+			end.reason = Endpoint::NO_EVENTS;
+			end.age = last;
+			return events;
+		}
+		if (t > age)
+			return events;
+		step();
+		events++;
+		last = t;
+		count(types);
+		if (end.type >= 0 && types[end.type] > 0)
+			end.reason = Endpoint::FIRST_CELL;
+		else if (end.volume > 0.0 && (types[DYSPLASIA]+types[CANCER])*cell_volume >= end.volume)
+			end.reason = Endpoint::VOLUME;
+		else continue;
+		end.age = t;
+		return events;
+	}
+}
+
+double Patient::next_event() const
+{
+	if (grid == NULL)
+		return clone_age();
+	return grid->nextEventTime()+clone_age();
+}
+
+void Patient::step()
+{
+	assert(grid != NULL || clone_cell >= 0);
+	if (grid == NULL)
+		build();
+	else
+		grid->execNextEvent();
+}
+
+void Patient::count(int types[NUM_CELL_TYPES]) const
+{
+	if (grid == NULL)
+	{
+		const Parameters* p = Parameters::getInstance();
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			types[i] = 0;
+		types[BE] = be_cells();
+		types[NORMAL] = p->xdim()*p->ydim()*p->zdim()-types[BE];
+		return;
+	}
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		types[i] = grid->census().count(i);
+}
+
+void follow_patient(Patient& patient, const std::vector<double>& ages,
+	Random* rng, const Protocol* protocol, int endoscopies,
+	int* counts, double* detected)
+{
+	const Parameters* p = Parameters::getInstance();
+	BiopsyIndex* index = NULL;
+	if (protocol != NULL)
+		index = new BiopsyIndex(p->xdim(),p->ydim(),protocol->biopsy_depth());
+	for (unsigned a = 0; a < ages.size(); a++)
+	{
+		patient.run_to(ages[a]);
+		patient.count(counts+a*NUM_CELL_TYPES);
+		if (index == NULL)
+			continue;
+		index->clear();
+		if (patient.spatial())
+			index->add(patient.tissue());
+		// A hybrid patient with no clone is its BE segment
+		else
+		{
+			for (int y = 0; y < patient.be_length() && y < p->ydim(); y++)
+				for (int x = 0; x < p->xdim(); x++)
+					index->add(x,y,0,BE);
+		}
+		index->update();
+		protocol->sensitivity(*index,patient.be_length(),rng,endoscopies,
+			detected+a*NUM_CELL_TYPES);
+	}
+	delete index;
+}
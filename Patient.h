@@ -0,0 +1,190 @@
+#ifndef _patient_h_
+#define _patient_h_
+#include "common.h"
+#include "TissueGrid.h"
+#include "Biopsy.h"
+#include <iostream>
+#include <vector>
+
+/**
+ * Calculate the length of the BE segment in grid points.
+ */
+int calculate_be_length(Random* rng);
+
+/**
+ * Fork n of a patient uses this stream number plus n of the patient's
+ * seed. It is far from the streams used by the ParallelTissue.
+ */
+#define FORK_STREAM 0x80000000UL
+
+/**
+ * A condition that ends the simulation of a patient as soon as its
+ * outcome is decided, either the first cell of a type or a volume of
+ * DYSPLASIA and CANCER. A simulation also ends when no events are left,
+ * because then nothing can change. After a run the reason and age say
+ * how and when it ended.
+ */
+struct Endpoint
+{
+	/// What ended a run
+	enum Reason { LAST_AGE, FIRST_CELL, VOLUME, NO_EVENTS };
+	int type; // End at the first cell of this type or -1 for none
+	double volume; // End when DYSPLASIA and CANCER fill this many cubic mm or 0 for none
+	Reason reason; // Why the run ended
+	double age; // Age at which it ended
+	Endpoint(int type = -1, double volume = 0.0):
+		type(type),volume(volume),reason(LAST_AGE),age(0.0){}
+	/// Has the run ended before its last age?
+	bool reached() const { return reason != LAST_AGE; }
+	/// Name of the reason for the output files
+	const char* name() const;
+};
+
+/**
+ * One simulated patient. This is the BE segment, the age at which BE
+ * appears, and the TissueGrid that models the tissue. Every patient has
+ * its own stream of random numbers, so many patients can be simulated at
+ * once. The grid dimensions and other model parameters are taken from
+ * the Parameters object, which must be set up before a Patient is made.
+ *
+ * A hybrid patient does not build its grid until the first DYSPLASIA
+ * clone is born. Until then the tissue is the BE segment and nothing
+ * else can happen, so the first of the N BE cells to mutate does so
+ * after an exponential time with N times the rate of one cell and it is
+ * any one of them with equal probability. This is the first stage of
+ * the multistage clonal expansion model of Curtius et al. with no
+ * growth of the BE cells. The grid is then built with the clone and
+ * its time zero is the birth of the clone. Every clock of a new grid is
+ * exponential, so by their lack of memory this has the same
+ * distribution of futures as a patient that simulates every cell from
+ * the onset of BE. Patients with no clone by the last age cost O(1). If
+ * NORMAL cells can mutate, then the grid is built at once.
+ */
+class Patient
+{
+	public:
+		/**
+		 * Create a patient whose random numbers come from stream 0 of
+		 * the given seed. The aggregate and frontier flags are passed to
+		 * TissueGrid::aggregate_be and TissueGrid::frontier_only.
+		 */
+		Patient(unsigned long seed, bool aggregate = false, bool frontier = false,
+			bool hybrid = false);
+		/**
+		 * Create a copy of a patient at the given age that continues
+		 * with its own stream of random numbers. The clocks of the
+		 * copy are drawn again from that stream, so copies that use
+		 * different streams have independent futures. The origin
+		 * must have a grid.
+		 */
+		Patient(const Patient& origin, unsigned long stream, double age);
+		/**
+		 * Read a patient from a checkpoint made by save(). Returns NULL
+		 * if the checkpoint could not be read or does not match the
+		 * dimensions in the Parameters object.
+		 */
+		static Patient* restore(std::istream& in);
+		/**
+		 * Write the patient to a checkpoint. Restoring it gives exactly
+		 * the same future as continuing this patient. The patient must
+		 * have a grid.
+		 */
+		void save(std::ostream& out) const;
+		/**
+		 * Seed of the random numbers for this patient.
+		 */
+		unsigned long seed() const { return ranseed; }
+		/**
+		 * Position in the stream of random numbers. The seed, stream and
+		 * position reproduce the state of the patient at the end of a
+		 * run.
+		 */
+		uint64_t draws() const { return rng.position(); }
+		/**
+		 * Length of the BE segment in grid points.
+		 */
+		int be_length() const { return be_size; }
+		/**
+		 * Age in years at which BE appeared.
+		 */
+		double be_onset() const { return onset; }
+		/**
+		 * Simulate the tissue up to the given age and return the number
+		 * of events that were executed.
+		 */
+		unsigned long run_to(double age);
+		/**
+		 * Simulate the tissue up to the given age like run_to(), but one
+		 * event at a time so that the run ends with the event at which
+		 * the endpoint is reached. Then end.reason and end.age are set
+		 * and the patient is left at that age. Otherwise end is not
+		 * changed. Returns the number of events that were executed.
+		 */
+		unsigned long run_to(double age, Endpoint& end);
+		/**
+		 * Age of the next event or infinity if there is none. For a
+		 * hybrid patient with no grid this is the birth of the clone.
+		 */
+		double next_event() const;
+		/**
+		 * Execute the next event.
+		 */
+		void step();
+		/**
+		 * Count the cells of each type.
+		 */
+		void count(int types[NUM_CELL_TYPES]) const;
+		/**
+		 * Does the patient have a grid? Only a hybrid patient whose
+		 * first clone has not been born does not.
+		 */
+		bool spatial() const { return grid != NULL; }
+		/**
+		 * Age at which the first clone is born in a hybrid patient. It
+		 * is infinite if BE cells cannot mutate. This is the age at
+		 * time zero of the grid, which is the onset of BE if the
+		 * patient is not hybrid.
+		 */
+		double clone_age() const { return onset+t_clone; }
+		/**
+		 * Report every change of type in the grid to obs. The patient
+		 * must have a grid. A copy made by the fork constructor does
+		 * not report to obs.
+		 */
+		void observe(CellObserver* obs) { grid->observe(obs); }
+		/**
+		 * Get the tissue model. The patient must have a grid.
+		 */
+		const TissueGrid& tissue() const { return *grid; }
+		~Patient();
+	private:
+		Patient():rng(0),aggregate(false),frontier(false),t_clone(0.0),
+			clone_cell(-1),grid(NULL){}
+		Patient(const Patient&):rng(0){}
+		Patient& operator=(const Patient&) { return *this; }
+		unsigned long ranseed; // Seed of the random numbers
+		Random rng; // Random numbers for this patient only
+		int be_size; // Length of the BE segment
+		double onset; // Age at which BE appears
+		bool aggregate, frontier; // Options for the grid
+		double t_clone; // Time after onset of the first clone in a hybrid patient
+		int clone_cell; // Surface cell of the first clone or -1 if there is none
+		TissueGrid* grid; // The tissue
+		/// Number of BE cells on the surface
+		int be_cells() const;
+		/// Create the grid with the BE segment and, if there is one, the
+		/// first clone
+		void build();
+};
+
+/**
+ * Simulate a patient to each age, recording the count of each type and,
+ * if there is a protocol, the fraction of endoscopies that found each
+ * type. The arrays have NUM_CELL_TYPES entries for each age. The
+ * endoscopies draw from rng.
+ */
+void follow_patient(Patient& patient, const std::vector<double>& ages,
+	Random* rng, const Protocol* protocol, int endoscopies,
+	int* counts, double* detected);
+
+#endif
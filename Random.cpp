@@ -0,0 +1,271 @@
+#include "Random.h"
+#include "Checkpoint.h"
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+void Random::philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+	const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+	uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for (int round = 0; round < 10; round++)
+	{
+		uint64_t p0 = (uint64_t)M0*c0, p1 = (uint64_t)M1*c2;
+		uint32_t hi0 = p0 >> 32, lo0 = (uint32_t)p0;
+		uint32_t hi1 = p1 >> 32, lo1 = (uint32_t)p1;
+		c0 = hi1^c1^k0;
+		c1 = lo1;
+		c2 = hi0^c3^k1;
+		c3 = lo0;
+		k0 += W0; k1 += W1;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+void Random::philox_blocks(const uint32_t ctr[4], const uint32_t key[2], int n, uint32_t* out)
+{
+	const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+	const uint64_t first = ((uint64_t)ctr[1] << 32) | ctr[0];
+	// The blocks are independent, so this loop is vectorized
+	for (int i = 0; i < n; i++)
+	{
+		uint64_t pos = first+i;
+		uint32_t c0 = (uint32_t)pos, c1 = (uint32_t)(pos >> 32), c2 = ctr[2], c3 = ctr[3];
+		uint32_t k0 = key[0], k1 = key[1];
+		for (int round = 0; round < 10; round++)
+		{
+			uint64_t p0 = (uint64_t)M0*c0, p1 = (uint64_t)M1*c2;
+			uint32_t hi0 = p0 >> 32, lo0 = (uint32_t)p0;
+			uint32_t hi1 = p1 >> 32, lo1 = (uint32_t)p1;
+			c0 = hi1^c1^k0;
+			c1 = lo1;
+			c2 = hi0^c3^k1;
+			c3 = lo0;
+			k0 += W0; k1 += W1;
+		}
+		out[4*i] = c0; out[4*i+1] = c1; out[4*i+2] = c2; out[4*i+3] = c3;
+	}
+}
+
+void Random::log_array(const double* x, double* y, int n)
+{
+	// fdlibm's split of log(2) and the series 2s(1+z/3+z^2/5+...) for
+	// log((1+s)/(1-s)) with z = s*s. Writing the mantissa as m in
+	// [sqrt(1/2),sqrt(2)) keeps |s| below 0.172, so ten terms are enough.
+	const double ln2_hi = 6.93147180369123816490e-01;
+	const double ln2_lo = 1.90821492927058770002e-10;
+	const double two52 = 4503599627370496.0;
+	for (int i = 0; i < n; i++)
+	{
+		uint64_t bits, ebits;
+		double m, e;
+		memcpy(&bits,&x[i],sizeof(double));
+		// The exponent as a double without an integer conversion
+		ebits = (bits >> 52) | 0x4330000000000000ULL;
+		memcpy(&e,&ebits,sizeof(double));
+		e -= two52+1023.0;
+		bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+		memcpy(&m,&bits,sizeof(double));
+		bool big = (m > M_SQRT2);
+		m = big ? 0.5*m : m;
+		e = big ? e+1.0 : e;
+		double s = (m-1.0)/(m+1.0), z = s*s;
+		double poly = 1.0/19.0;
+		poly = poly*z+1.0/17.0;
+		poly = poly*z+1.0/15.0;
+		poly = poly*z+1.0/13.0;
+		poly = poly*z+1.0/11.0;
+		poly = poly*z+1.0/9.0;
+		poly = poly*z+1.0/7.0;
+		poly = poly*z+1.0/5.0;
+		poly = poly*z+1.0/3.0;
+		poly = poly*z+1.0;
+		y[i] = e*ln2_hi+(e*ln2_lo+2.0*s*poly);
+	}
+}
+
+Random::Random(unsigned long seed, unsigned long stream):
+	pooled_draws(false)
+{
+	set_seed(seed,stream);
+}
+
+void Random::set_seed(unsigned long seed, unsigned long stream)
+{
+	uint64_t s = seed, n = stream;
+	key[0] = (uint32_t)s; key[1] = (uint32_t)(s >> 32);
+	ctr[0] = ctr[1] = 0;
+	ctr[2] = (uint32_t)n; ctr[3] = (uint32_t)(n >> 32);
+	used = 4;
+	next_exp = next_dir6 = next_dir4 = POOL_SIZE;
+}
+
+void Random::pool(bool flag)
+{
+	pooled_draws = flag;
+	next_exp = next_dir6 = next_dir4 = POOL_SIZE;
+}
+
+void Random::next_blocks(uint32_t* words, int n)
+{
+	assert(n%4 == 0);
+	philox_blocks(ctr,key,n/4,words);
+	uint64_t pos = (((uint64_t)ctr[1] << 32) | ctr[0])+n/4;
+	ctr[0] = (uint32_t)pos; ctr[1] = (uint32_t)(pos >> 32);
+}
+
+void Random::fill_exp()
+{
+	const double two52 = 4503599627370496.0;
+	uint32_t words[POOL_SIZE];
+	double x[POOL_SIZE];
+	next_blocks(words,POOL_SIZE);
+	// 1-u for u in [0,1) without an unsigned conversion
+	for (int i = 0; i < POOL_SIZE; i++)
+	{
+		uint64_t bits = words[i] | 0x4330000000000000ULL;
+		double w;
+		memcpy(&w,&bits,sizeof(double));
+		x[i] = 1.0-(w-two52)*(1.0/4294967296.0);
+	}
+	log_array(x,exp_pool,POOL_SIZE);
+	for (int i = 0; i < POOL_SIZE; i++)
+		exp_pool[i] = -exp_pool[i];
+	next_exp = 0;
+}
+
+void Random::fill_dir6()
+{
+	// Each word gives a uniform integer in [0,6^8) by the same multiply
+	// and shift as uniform_int. Its eight base 6 digits are independent
+	// directions.
+	const uint32_t range = 1679616;
+	const uint32_t threshold = (0U-range)%range;
+	uint32_t words[POOL_SIZE/8];
+	next_blocks(words,POOL_SIZE/8);
+	for (int i = 0; i < POOL_SIZE/8; i++)
+	{
+		uint64_t m = (uint64_t)words[i]*range;
+		// Biased values are very rare
+		while ((uint32_t)m < threshold)
+			m = (uint64_t)next()*range;
+		uint32_t v = (uint32_t)(m >> 32);
+		for (int j = 0; j < 8; j++)
+		{
+			dir6_pool[8*i+j] = v%6;
+			v /= 6;
+		}
+	}
+	next_dir6 = 0;
+}
+
+void Random::fill_dir4()
+{
+	// Every two bits of a word are a direction
+	uint32_t words[POOL_SIZE/16];
+	next_blocks(words,POOL_SIZE/16);
+	for (int i = 0; i < POOL_SIZE; i++)
+		dir4_pool[i] = (words[i/16] >> (2*(i%16))) & 3;
+	next_dir4 = 0;
+}
+
+double Random::draw_exponential(double mu)
+{
+	if (pooled_draws)
+	{
+		fill_exp();
+		return mu*exp_pool[next_exp++];
+	}
+	return -mu*log1p(-uniform());
+}
+
+void Random::save(std::ostream& out) const
+{
+	save_value(out,key);
+	save_value(out,ctr);
+	save_value(out,block);
+	save_value(out,used);
+	save_value(out,pooled_draws);
+	save_value(out,exp_pool);
+	save_value(out,dir6_pool);
+	save_value(out,dir4_pool);
+	save_value(out,next_exp);
+	save_value(out,next_dir6);
+	save_value(out,next_dir4);
+}
+
+bool Random::load(std::istream& in)
+{
+	return load_value(in,key) && load_value(in,ctr) &&
+		load_value(in,block) && load_value(in,used) &&
+		used >= 0 && used <= 4 &&
+		load_value(in,pooled_draws) && load_value(in,exp_pool) &&
+		load_value(in,dir6_pool) && load_value(in,dir4_pool) &&
+		load_value(in,next_exp) && load_value(in,next_dir6) &&
+		load_value(in,next_dir4) &&
+		next_exp >= 0 && next_exp <= POOL_SIZE &&
+		next_dir6 >= 0 && next_dir6 <= POOL_SIZE &&
+		next_dir4 >= 0 && next_dir4 <= POOL_SIZE;
+}
+
+double Random::uniform()
+{
+	return next()*(1.0/4294967296.0);
+}
+
+unsigned long Random::uniform_int(unsigned long n)
+{
+	assert(n > 0 && n <= 0xFFFFFFFFUL);
+	// Lemire's multiply and shift with rejection of the biased values
+	uint32_t range = (uint32_t)n;
+	uint64_t m = (uint64_t)next()*range;
+	uint32_t low = (uint32_t)m;
+	if (low < range)
+	{
+		uint32_t threshold = (0U-range)%range;
+		while (low < threshold)
+		{
+			m = (uint64_t)next()*range;
+			low = (uint32_t)m;
+		}
+	}
+	return (unsigned long)(m >> 32);
+}
+
+double Random::normal(double mean, double std_dev)
+{
+	// Polar method with the spread used by the original gsl version
+	double sigma = sqrt(std_dev), x, y, r2;
+	do
+	{
+		x = 2.0*uniform()-1.0;
+		y = 2.0*uniform()-1.0;
+		r2 = x*x+y*y;
+	}
+	while (r2 > 1.0 || r2 == 0.0);
+	return sigma*y*sqrt(-2.0*log(r2)/r2)+mean;
+}
+
+// Offsets of the neighbors. The first four are the 2D directions. A
+// table avoids a branch that is mispredicted on most draws.
+static const int offsets[6][3] =
+{
+	{ 1, 0, 0 }, { -1, 0, 0 },
+	{ 0, 1, 0 }, { 0, -1, 0 },
+	{ 0, 0, 1 }, { 0, 0, -1 }
+};
+
+void Random::direction(int& dx, int& dy, int& dz)
+{
+	const int* d = offsets[direction(6)];
+	dx = d[0]; dy = d[1]; dz = d[2];
+}
+
+void Random::direction(int& dx, int& dy)
+{
+	const int* d = offsets[direction(4)];
+	dx = d[0]; dy = d[1];
+}
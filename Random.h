@@ -0,0 +1,155 @@
+#ifndef _random_h_
+#define _random_h_
+#include <stdint.h>
+#include <iostream>
+
+/**
+ * A stream of random numbers and the distributions used by the model.
+ * The numbers come from the Philox4x32-10 counter based generator of
+ * Salmon et al. (2011), Parallel Random Numbers: As Easy as 1, 2, 3.
+ * A stream is identified by a seed, usually the replicate, and a stream
+ * number, which might be a voxel or an event index. The numbers in a
+ * stream depend only on these two values, so simulations give the same
+ * results whatever the number of threads or the order in which they run.
+ * Simulations that run at the same time must each have their own Random
+ * object, but copying a Random object is cheap.
+ *
+ * A stream can be pooled. Then exponential() and direction() hand out
+ * values from buffers that are refilled POOL_SIZE at a time from whole
+ * Philox blocks. A word of the stream gives one exponential, eight 3D
+ * directions or sixteen 2D directions. The loops that fill them have no branches or calls, so
+ * the compiler can vectorize them for the SIMD units of the machine
+ * (e.g. with OPTFLAG=-march=native). The distributions are the same but
+ * the values differ from those of a stream that is not pooled. The
+ * buffers are part of the state of the stream and are copied and saved
+ * with it.
+ */
+class Random
+{
+	public:
+		/**
+		 * Create a stream with the given seed and stream number.
+		 */
+		Random(unsigned long seed = 0, unsigned long stream = 0);
+		/**
+		 * Set the random number seed and stream number. This restarts
+		 * the stream.
+		 */
+		void set_seed(unsigned long seed, unsigned long stream = 0);
+		/**
+		 * Turn pooling on or off. This discards any values left in
+		 * the pools.
+		 */
+		void pool(bool flag);
+		bool pooled() const { return pooled_draws; }
+		/**
+		 * Sample an exponential distribution with mean mu.
+		 */
+		double exponential(double mu)
+		{
+			if (pooled_draws && next_exp < POOL_SIZE)
+				return mu*exp_pool[next_exp++];
+			return draw_exponential(mu);
+		}
+		/**
+		 * Return a number in [0,1]
+		 */
+		double uniform();
+		/**
+		 * Return an integer in [0,n)
+		 */
+		unsigned long uniform_int(unsigned long n);
+		/** Sample a normal distribution */
+		double normal(double mean, double std_dev);
+		/**
+		 * Select a 3D direction at random.
+		 */
+		void direction(int& dx, int& dy, int& dz);
+		/**
+		 * Select a 2D direction at random.
+		 */
+		void direction(int& dx, int& dy);
+		/**
+		 * Select one of dirs directions at random and return its index.
+		 * The pools are used for 6 and 4 directions. The 3D and 2D
+		 * directions above are the entries of the index for 6 and 4 in
+		 * a table of neighbor offsets.
+		 */
+		int direction(int dirs)
+		{
+			if (!pooled_draws || (dirs != 6 && dirs != 4))
+				return uniform_int(dirs);
+			if (dirs == 6)
+			{
+				if (next_dir6 == POOL_SIZE) fill_dir6();
+				return dir6_pool[next_dir6++];
+			}
+			if (next_dir4 == POOL_SIZE) fill_dir4();
+			return dir4_pool[next_dir4++];
+		}
+		/**
+		 * Number of 32 bit words drawn from the stream so far, counting
+		 * those that filled the pools. With the seed and stream number
+		 * this says where in its stream a simulation is.
+		 */
+		uint64_t position() const
+		{
+			return 4*((((uint64_t)ctr[1]) << 32) | ctr[0])-(4-used);
+		}
+		/**
+		 * Write the position in the stream to a checkpoint.
+		 */
+		void save(std::ostream& out) const;
+		/**
+		 * Read the position in the stream from a checkpoint. Returns
+		 * false if the checkpoint could not be read.
+		 */
+		bool load(std::istream& in);
+		/**
+		 * Apply the Philox4x32-10 bijection to a counter and key.
+		 */
+		static void philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+		/**
+		 * Apply the bijection to the n counters that start at ctr and
+		 * put the 4*n words into out. Only the first two words of the
+		 * counter are incremented.
+		 */
+		static void philox_blocks(const uint32_t ctr[4], const uint32_t key[2], int n, uint32_t* out);
+		/**
+		 * Put the natural log of each of the n positive, normal values
+		 * in x into y. The error is within a few ulp of std::log.
+		 */
+		static void log_array(const double* x, double* y, int n);
+		/// Number of values in each pool
+		static const int POOL_SIZE = 64;
+	private:
+		uint32_t key[2]; // The seed
+		uint32_t ctr[4]; // Position in the stream followed by the stream number
+		uint32_t block[4]; // Output for the current counter
+		int used; // Number of words of block already returned
+		bool pooled_draws; // Draw from the pools?
+		double exp_pool[POOL_SIZE]; // Exponentials with a mean of one
+		uint8_t dir6_pool[POOL_SIZE]; // 3D directions
+		uint8_t dir4_pool[POOL_SIZE]; // 2D directions
+		int next_exp, next_dir6, next_dir4; // Next value in each pool
+		/// Exponential from the stream or from a refilled pool
+		double draw_exponential(double mu);
+		/// Fill words with n values from the next n/4 blocks
+		void next_blocks(uint32_t* words, int n);
+		void fill_exp();
+		void fill_dir6();
+		void fill_dir4();
+		/// Get the next 32 random bits
+		uint32_t next()
+		{
+			if (used == 4)
+			{
+				philox(ctr,key,block);
+				used = 0;
+				if (++ctr[0] == 0) ++ctr[1];
+			}
+			return block[used++];
+		}
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _ring_buffer_h_
+#define _ring_buffer_h_
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/**
+ * A bounded queue between exactly one thread that puts items in and one
+ * thread that takes them out. Neither takes a lock. The producer alone
+ * writes the tail and the consumer alone writes the head, and each reads
+ * the index of the other with acquire ordering, so an item is completely
+ * written before the consumer can see it and completely read before the
+ * producer can reuse its slot. The capacity is a power of two, so the
+ * positions wrap with a mask, and the indices are on separate cache
+ * lines so that the threads do not contend for them.
+ */
+template <typename T> class RingBuffer
+{
+	public:
+		/**
+		 * Create a buffer that holds at least capacity items.
+		 */
+		RingBuffer(size_t capacity):
+			head(0),tail(0)
+		{
+			size_t n = 1;
+			while (n < capacity)
+				n <<= 1;
+			items.resize(n);
+			mask = n-1;
+		}
+		/**
+		 * Put an item at the back of the queue. Returns false at once if
+		 * the queue is full. Only the producer may call this.
+		 */
+		bool push(const T& item)
+		{
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t-head.load(std::memory_order_acquire) == items.size())
+				return false;
+			items[t&mask] = item;
+			tail.store(t+1,std::memory_order_release);
+			return true;
+		}
+		/**
+		 * Take the item at the front of the queue. Returns false at once
+		 * if the queue is empty. Only the consumer may call this.
+		 */
+		bool pop(T& item)
+		{
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire))
+				return false;
+			item = items[h&mask];
+			head.store(h+1,std::memory_order_release);
+			return true;
+		}
+		/**
+		 * Number of items the buffer can hold.
+		 */
+		size_t capacity() const { return items.size(); }
+	private:
+		RingBuffer(const RingBuffer&);
+		RingBuffer& operator=(const RingBuffer&);
+		std::vector<T> items; // Slots for the items
+		size_t mask; // Capacity minus one
+		char pad0[64];
+		std::atomic<size_t> head; // Position of the next item to take
+		char pad1[64];
+		std::atomic<size_t> tail; // Position of the next free slot
+		char pad2[64];
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef _rules_h_
+#define _rules_h_
+#include "common.h"
+
+/**
+ * The transition rules of the model as a policy class. The engines call
+ * the static functions of ModelRules, which is chosen when the model is
+ * compiled, so a variant of the rules is inlined into the engines and
+ * costs nothing at run time. Select a variant with, e.g.,
+ * make OPTFLAG=-DRULES=MooreRules. A policy provides
+ *
+ * mutates_to(iType): The type that a cell of type iType mutates into. A
+ *	type that never mutates gives itself.
+ * can_expand(iType): Can a cell of type iType expand into its neighbors?
+ * can_invade(iType, oldType, z): Does an expansion of type iType change
+ *	a cell of type oldType at depth z into type iType?
+ * stencil_size(iType): The number of directions that a cell of type
+ *	iType can expand in. These are the first stencil_size(iType)
+ *	entries of the stencil.
+ * offset(d): The x, y and z offsets of direction d of the stencil. The
+ *	stencil must contain the opposite of each of its directions.
+ * MAX_STENCIL: The size of the whole stencil.
+ * wrap(x, y, z, nx, ny, nz): Apply the boundary to a point and return
+ *	false if it is outside of the space.
+ *
+ * The tables are indexed by type, so the rules have no branches on the
+ * type of a cell. The number of types is still NUM_CELL_TYPES because
+ * the cell types are stored, counted and written out by that number.
+ */
+
+/**
+ * The model of Curtius et al. Cells mutate from NORMAL to BE to
+ * DYSPLASIA to CANCER. DYSPLASIA expands along the surface into BE and
+ * CANCER expands in 3D into anything. The neighbors are the von Neumann
+ * neighborhood of 6 cells, of which the first 4 are on the surface. The
+ * space wraps around the circumference and is closed at the ends and at
+ * the inner and outer surfaces of the wall.
+ */
+struct EsophagusRules
+{
+	static const int MAX_STENCIL = 6;
+	static int mutates_to(int iType)
+	{
+		static const int next[NUM_CELL_TYPES] = { BE, DYSPLASIA, CANCER, CANCER };
+		return next[iType];
+	}
+	static bool can_expand(int iType)
+	{
+		static const bool expands[NUM_CELL_TYPES] = { false, false, true, true };
+		return expands[iType];
+	}
+	static bool can_invade(int iType, int oldType, int)
+	{
+		// Rows are the invader and columns the cell that is invaded
+		static const bool invades[NUM_CELL_TYPES][NUM_CELL_TYPES] = {
+			{ false, false, false, false },
+			{ false, false, false, false },
+			{ false, true, false, false },
+			{ true, true, true, false }
+		};
+		return invades[iType][oldType];
+	}
+	static int stencil_size(int iType)
+	{
+		static const int size[NUM_CELL_TYPES] = { 0, 0, 4, 6 };
+		return size[iType];
+	}
+	static const int* offset(int d)
+	{
+		// The order used by Random::direction
+		static const int offsets[MAX_STENCIL][3] = {
+			{ 1, 0, 0 }, { -1, 0, 0 },
+			{ 0, 1, 0 }, { 0, -1, 0 },
+			{ 0, 0, 1 }, { 0, 0, -1 }
+		};
+		return offsets[d];
+	}
+	static bool wrap(int& x, int& y, int& z, int nx, int ny, int nz)
+	{
+		if (x < 0) x = nx-1;
+		else if (x >= nx) x = 0;
+		return (y >= 0 && y < ny && z >= 0 && z < nz);
+	}
+};
+
+/**
+ * The same rules with the Moore neighborhood of 26 cells, of which the
+ * first 8 are on the surface.
+ */
+struct MooreRules: public EsophagusRules
+{
+	static const int MAX_STENCIL = 26;
+	static int stencil_size(int iType)
+	{
+		static const int size[NUM_CELL_TYPES] = { 0, 0, 8, 26 };
+		return size[iType];
+	}
+	static const int* offset(int d)
+	{
+		static const int offsets[MAX_STENCIL][3] = {
+			{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 },
+			{ 1, 1, 0 }, { -1, -1, 0 }, { 1, -1, 0 }, { -1, 1, 0 },
+			{ 0, 0, 1 }, { 0, 0, -1 },
+			{ 1, 0, 1 }, { -1, 0, -1 }, { 1, 0, -1 }, { -1, 0, 1 },
+			{ 0, 1, 1 }, { 0, -1, -1 }, { 0, 1, -1 }, { 0, -1, 1 },
+			{ 1, 1, 1 }, { -1, -1, -1 }, { 1, 1, -1 }, { -1, -1, 1 },
+			{ 1, -1, 1 }, { -1, 1, -1 }, { 1, -1, -1 }, { -1, 1, 1 }
+		};
+		return offsets[d];
+	}
+};
+
+/**
+ * The model of Curtius et al. with cancer confined to the first DEPTH
+ * cells below the surface, e.g. to the mucosa.
+ */
+template <int DEPTH> struct ConfinedRules: public EsophagusRules
+{
+	static bool can_invade(int iType, int oldType, int z)
+	{
+		return (z < DEPTH) && EsophagusRules::can_invade(iType,oldType,z);
+	}
+};
+
+#ifndef RULES
+#define RULES EsophagusRules
+#endif
+
+/**
+ * The rules used by the engines.
+ */
+typedef RULES ModelRules;
+
+#endif
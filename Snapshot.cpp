@@ -0,0 +1,333 @@
+#include "Snapshot.h"
+#include "common.h"
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <zlib.h>
+#include <chrono>
+
+SnapshotWriter::SnapshotWriter(Format format, bool compress, int keyframes):
+	format(format),
+	compress(compress),
+	keyframes(keyframes),
+	since_key(0),
+	prev_seq(-1),
+	busy(false),
+	secs(0.0),
+	stop(false),
+	worker(&SnapshotWriter::run,this)
+{
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		stop = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+bool SnapshotWriter::parse_format(const char* name, Format& format)
+{
+	if (strcmp(name,"csv") == 0) format = CSV;
+	else if (strcmp(name,"raw") == 0) format = RAW;
+	else if (strcmp(name,"vti") == 0) format = VTI;
+	else if (strcmp(name,"delta") == 0) format = DELTA;
+	else return false;
+	return true;
+}
+
+void SnapshotWriter::write(Snapshot* s)
+{
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		while (queue.size() >= max_queue)
+			idle.wait(guard);
+		queue.push_back(s);
+	}
+	wake.notify_one();
+}
+
+double SnapshotWriter::write_seconds()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	return secs;
+}
+
+void SnapshotWriter::flush()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (!queue.empty() || busy)
+		idle.wait(guard);
+}
+
+void SnapshotWriter::run()
+{
+	for (;;)
+	{
+		Snapshot* s;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (queue.empty() && !stop)
+				wake.wait(guard);
+			if (queue.empty())
+				return;
+			s = queue.front();
+			queue.pop_front();
+			busy = true;
+		}
+		auto start = std::chrono::steady_clock::now();
+		if (format == CSV) write_csv(*s);
+		else if (format == RAW) write_raw(*s);
+		else if (format == VTI) write_vti(*s);
+		else write_delta(*s);
+		delete s;
+		double write_secs = std::chrono::duration<double>(
+			std::chrono::steady_clock::now()-start).count();
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			busy = false;
+			secs += write_secs;
+		}
+		idle.notify_all();
+	}
+}
+
+void SnapshotWriter::write_csv(const Snapshot& s)
+{
+	char filename[100];
+	sprintf(filename,"tumor.csv.%d",s.seq_num);
+	FILE* fout = fopen(filename,"w");
+	if (fout == NULL)
+		return;
+	fprintf(fout,"xcoord,ycoord,zcoord,type\n");
+	for (int i = 0; i < s.nx; i++)
+		for (int j = 0; j < s.ny; j++)
+			for (int k = 0; k < s.nz; k++)
+				if (s.at(i,j,k) >= BE)
+					fprintf(fout,"%d,%d,%d,%d\n",i,j,k,s.at(i,j,k));
+	fclose(fout);
+}
+
+/**
+ * Fill the 40 byte header of a RAW or DELTA file.
+ */
+static void make_header(char header[40], const char* magic, const Snapshot& s, int32_t base)
+{
+	int32_t dims[4] = { s.nx, s.ny, s.nz, base };
+	memcpy(header,magic,8);
+	memcpy(header+8,dims,sizeof(dims));
+	memcpy(header+24,&s.t,sizeof(double));
+	memcpy(header+32,&s.dx,sizeof(double));
+}
+
+/**
+ * Write a header and the data after it to a file, gzipped if the flag
+ * is set.
+ */
+static void write_file(const char* filename, bool compress, const char header[40],
+	const unsigned char* data, size_t size)
+{
+	if (compress)
+	{
+		gzFile fout = gzopen(filename,"wb");
+		if (fout == NULL)
+			return;
+		gzwrite(fout,header,40);
+		gzwrite(fout,data,size);
+		gzclose(fout);
+	}
+	else
+	{
+		FILE* fout = fopen(filename,"wb");
+		if (fout == NULL)
+			return;
+		fwrite(header,1,40,fout);
+		fwrite(data,1,size,fout);
+		fclose(fout);
+	}
+}
+
+void SnapshotWriter::write_raw(const Snapshot& s)
+{
+	char header[40];
+	make_header(header,"ESOTYPE1",s,0);
+	char filename[100];
+	sprintf(filename,(compress) ? "tumor.raw.%d.gz" : "tumor.raw.%d",s.seq_num);
+	write_file(filename,compress,header,s.types.data(),s.types.size());
+}
+
+void SnapshotWriter::write_delta(Snapshot& s)
+{
+	char header[40];
+	char filename[100];
+	sprintf(filename,(compress) ? "tumor.delta.%d.gz" : "tumor.delta.%d",s.seq_num);
+	const size_t n = s.types.size();
+	if (previous.size() != n || ++since_key >= keyframes)
+	{
+		make_header(header,"ESOTYPE1",s,0);
+		write_file(filename,compress,header,s.types.data(),n);
+		since_key = 0;
+	}
+	else
+	{
+		// The count goes first and is filled in at the end
+		std::vector<unsigned char> changes(4);
+		const unsigned char* a = previous.data();
+		const unsigned char* b = s.types.data();
+		for (size_t i = 0; i < n; i += 8)
+		{
+			// Skip eight cells at a time while nothing has changed
+			uint64_t x, y;
+			if (i+8 <= n)
+			{
+				memcpy(&x,a+i,8);
+				memcpy(&y,b+i,8);
+				if (x == y)
+					continue;
+			}
+			for (size_t j = i; j < i+8 && j < n; j++)
+			{
+				if (a[j] == b[j])
+					continue;
+				uint32_t cell = j;
+				unsigned char pair[5];
+				memcpy(pair,&cell,4);
+				pair[4] = b[j];
+				changes.insert(changes.end(),pair,pair+5);
+			}
+		}
+		uint32_t count = (changes.size()-4)/5;
+		memcpy(changes.data(),&count,4);
+		make_header(header,"ESODELT1",s,prev_seq);
+		write_file(filename,compress,header,changes.data(),changes.size());
+	}
+	// The snapshot is deleted after it is written, so take its types
+	previous.swap(s.types);
+	prev_seq = s.seq_num;
+}
+
+Snapshot* read_delta(int seq_num)
+{
+	char filename[100];
+	sprintf(filename,"tumor.delta.%d.gz",seq_num);
+	gzFile fin = gzopen(filename,"rb");
+	if (fin == NULL)
+	{
+		sprintf(filename,"tumor.delta.%d",seq_num);
+		fin = gzopen(filename,"rb");
+	}
+	if (fin == NULL)
+		return NULL;
+	char header[40];
+	int32_t dims[4];
+	double t, dx;
+	Snapshot* s = NULL;
+	if (gzread(fin,header,sizeof(header)) == (int)sizeof(header))
+	{
+		memcpy(dims,header+8,sizeof(dims));
+		memcpy(&t,header+24,sizeof(double));
+		memcpy(&dx,header+32,sizeof(double));
+		// A keyframe
+		if (memcmp(header,"ESOTYPE1",8) == 0)
+		{
+			s = new Snapshot(seq_num,t,dims[0],dims[1],dims[2],dx);
+			if (gzread(fin,s->types.data(),s->types.size()) != (int)s->types.size())
+			{
+				delete s;
+				s = NULL;
+			}
+		}
+		// Changes to the snapshot before it, which must come earlier
+		else if (memcmp(header,"ESODELT1",8) == 0 && dims[3] >= 0 && dims[3] < seq_num)
+		{
+			s = read_delta(dims[3]);
+			uint32_t count;
+			if (s != NULL && (s->nx != dims[0] || s->ny != dims[1] || s->nz != dims[2] ||
+				gzread(fin,&count,4) != 4))
+			{
+				delete s;
+				s = NULL;
+			}
+			for (uint32_t i = 0; s != NULL && i < count; i++)
+			{
+				unsigned char pair[5];
+				uint32_t cell = 0;
+				if (gzread(fin,pair,5) == 5)
+					memcpy(&cell,pair,4);
+				else cell = s->types.size();
+				if (cell < s->types.size())
+					s->types[cell] = pair[4];
+				else
+				{
+					delete s;
+					s = NULL;
+				}
+			}
+			if (s != NULL)
+			{
+				s->seq_num = seq_num;
+				s->t = t;
+			}
+		}
+	}
+	gzclose(fin);
+	return s;
+}
+
+void SnapshotWriter::write_vti(const Snapshot& s)
+{
+	char filename[100];
+	sprintf(filename,"tumor.%d.vti",s.seq_num);
+	FILE* fout = fopen(filename,"wb");
+	if (fout == NULL)
+		return;
+	fprintf(fout,"<?xml version=\"1.0\"?>\n");
+	fprintf(fout,"<VTKFile type=\"ImageData\" version=\"1.0\" "
+		"byte_order=\"LittleEndian\" header_type=\"UInt64\"%s>\n",
+		(compress) ? " compressor=\"vtkZLibDataCompressor\"" : "");
+	fprintf(fout,"<ImageData WholeExtent=\"0 %d 0 %d 0 %d\" "
+		"Origin=\"0 0 0\" Spacing=\"%g %g %g\">\n",
+		s.nx-1,s.ny-1,s.nz-1,s.dx,s.dx,s.dx);
+	fprintf(fout,"<FieldData>\n<DataArray type=\"Float64\" Name=\"TimeValue\" "
+		"NumberOfTuples=\"1\" format=\"ascii\">%.17g</DataArray>\n</FieldData>\n",s.t);
+	fprintf(fout,"<Piece Extent=\"0 %d 0 %d 0 %d\">\n",s.nx-1,s.ny-1,s.nz-1);
+	fprintf(fout,"<PointData Scalars=\"type\">\n");
+	fprintf(fout,"<DataArray type=\"UInt8\" Name=\"type\" format=\"appended\" offset=\"0\"/>\n");
+	fprintf(fout,"</PointData>\n</Piece>\n</ImageData>\n");
+	fprintf(fout,"<AppendedData encoding=\"raw\">\n_");
+	const uint64_t size = s.types.size();
+	if (!compress)
+	{
+		fwrite(&size,sizeof(size),1,fout);
+		fwrite(s.types.data(),1,size,fout);
+	}
+	else
+	{
+		// The header is the number of blocks, the block size, the size of
+		// the last block, and then the compressed size of every block.
+		const uint64_t block = 1<<20;
+		const uint64_t blocks = (size+block-1)/block;
+		std::vector<uint64_t> header(3+blocks);
+		std::vector<std::vector<unsigned char> > data(blocks);
+		header[0] = blocks;
+		header[1] = block;
+		header[2] = (blocks == 0) ? 0 : size-(blocks-1)*block;
+		for (uint64_t b = 0; b < blocks; b++)
+		{
+			uLong in = (b == blocks-1) ? header[2] : block;
+			uLongf out = compressBound(in);
+			data[b].resize(out);
+			compress2(data[b].data(),&out,s.types.data()+b*block,in,Z_DEFAULT_COMPRESSION);
+			data[b].resize(out);
+			header[3+b] = out;
+		}
+		fwrite(header.data(),sizeof(uint64_t),header.size(),fout);
+		for (uint64_t b = 0; b < blocks; b++)
+			fwrite(data[b].data(),1,data[b].size(),fout);
+	}
+	fprintf(fout,"\n</AppendedData>\n</VTKFile>\n");
+	fclose(fout);
+}
@@ -0,0 +1,122 @@
+#ifndef _snapshot_h_
+#define _snapshot_h_
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * A copy of the cell types in the grid at one instant. The types are
+ * stored one byte per cell with x varying fastest, then y, then z. This
+ * is the order expected by VTK and by the raw image readers in paraview.
+ */
+struct Snapshot
+{
+	int seq_num; // Number of the snapshot, used to name the file
+	double t; // Age at which it was taken
+	int nx, ny, nz; // Size of the grid
+	double dx; // Size of a cell in mm
+	std::vector<unsigned char> types; // Cell types
+	Snapshot(int seq_num, double t, int nx, int ny, int nz, double dx):
+		seq_num(seq_num),t(t),nx(nx),ny(ny),nz(nz),dx(dx),
+		types(nx*ny*nz){}
+	unsigned char& at(int x, int y, int z) { return types[(z*ny+y)*nx+x]; }
+	unsigned char at(int x, int y, int z) const { return types[(z*ny+y)*nx+x]; }
+};
+
+/**
+ * Writes snapshots to disk on a background thread so that the
+ * simulation can continue while the files are written. The formats are
+ *
+ * CSV: tumor.csv.N, the original list of points that are not NORMAL.
+ * RAW: tumor.raw.N, a 40 byte header followed by one byte per cell. The
+ *	header is the characters ESOTYPE1, the int32 values nx, ny, nz and 0,
+ *	and the float64 values t and dx. All values are little endian.
+ * VTI: tumor.N.vti, a VTK ImageData file with a UInt8 point array called
+ *	type and the age in the TimeValue field.
+ * DELTA: tumor.delta.N, a series in which every few snapshots is a
+ *	keyframe and the rest hold only the cells that changed since the
+ *	snapshot before them. A keyframe is a RAW file. Any other file has
+ *	a 40 byte header like that of a RAW file but with the characters
+ *	ESODELT1 and the number of the snapshot before it in place of the
+ *	0. A uint32 count and that many pairs of a uint32 cell and its
+ *	uint8 type follow. Cells are numbered in the order of the RAW
+ *	file. The first snapshot written is always a keyframe.
+ *
+ * If compression is on, RAW and DELTA files are gzipped and VTI files
+ * use the zlib compressor that paraview understands. CSV files are never
+ * compressed.
+ *
+ * At most one snapshot waits in the queue while another is written, so
+ * no more than three snapshots exist at once if the simulation gets
+ * ahead of the disk.
+ */
+class SnapshotWriter
+{
+	public:
+		enum Format { CSV, RAW, VTI, DELTA };
+		/**
+		 * Create a writer for the given format. A DELTA series has a
+		 * keyframe every keyframes snapshots.
+		 */
+		SnapshotWriter(Format format, bool compress, int keyframes = 10);
+		/**
+		 * Queue a snapshot to be written. The writer deletes it when
+		 * it is done. Blocks while the queue is full.
+		 */
+		void write(Snapshot* s);
+		/**
+		 * Wait for every queued snapshot to be written.
+		 */
+		void flush();
+		/**
+		 * Seconds spent writing snapshots so far. Call flush() first
+		 * to include every snapshot that was queued.
+		 */
+		double write_seconds();
+		/**
+		 * Parse the name of a format. Returns false if the name is
+		 * not recognized.
+		 */
+		static bool parse_format(const char* name, Format& format);
+		/**
+		 * Writes the remaining snapshots before returning.
+		 */
+		~SnapshotWriter();
+	private:
+		SnapshotWriter(const SnapshotWriter&);
+		SnapshotWriter& operator=(const SnapshotWriter&);
+		const Format format;
+		const bool compress;
+		const int keyframes; // Snapshots between keyframes of a series
+		int since_key; // Snapshots written since the last keyframe
+		std::vector<unsigned char> previous; // Last snapshot of a series
+		int prev_seq; // and its number
+		std::deque<Snapshot*> queue; // Snapshots waiting to be written
+		static const unsigned max_queue = 1; // Size of a full queue
+		bool busy; // Is a snapshot being written now?
+		double secs; // Time spent writing
+		bool stop; // Should the thread exit when the queue is empty?
+		std::mutex lock;
+		std::condition_variable wake; // Signals a new snapshot or stop
+		std::condition_variable idle; // Signals an empty queue
+		std::thread worker;
+		void run();
+		void write_csv(const Snapshot& s);
+		void write_raw(const Snapshot& s);
+		void write_vti(const Snapshot& s);
+		void write_delta(Snapshot& s);
+};
+
+/**
+ * Read snapshot N of a DELTA series from tumor.delta.N or
+ * tumor.delta.N.gz in the current directory. The snapshot is rebuilt
+ * from the keyframe before it and the changes after that keyframe.
+ * Returns NULL if a file of the series is missing or damaged. The
+ * caller must delete the snapshot.
+ */
+Snapshot* read_delta(int seq_num);
+
+#endif
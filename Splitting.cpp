@@ -0,0 +1,163 @@
+#include "Splitting.h"
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <fstream>
+
+/**
+ * The level that a patient has reached. This is its number of DYSPLASIA
+ * and CANCER cells, and any CANCER cell passes every level.
+ */
+static int score(const Patient& patient)
+{
+	int types[NUM_CELL_TYPES];
+	patient.count(types);
+	return (types[CANCER] > 0) ? INT_MAX : types[DYSPLASIA]+types[CANCER];
+}
+
+/**
+ * Simulate a patient that starts at the given age until it passes the
+ * level or reaches the final age. Returns the age at which it passed the
+ * level or a negative number if it did not.
+ */
+static double advance(Patient& patient, double start, double age, int level,
+	unsigned long& events)
+{
+	if (score(patient) >= level)
+		return start;
+	while (patient.next_event() <= age)
+	{
+		double t = patient.next_event();
+		patient.step();
+		events++;
+		if (score(patient) >= level)
+			return t;
+	}
+	return -1.0;
+}
+
+/**
+ * One replication of the splitting estimate. The fraction of
+ * trajectories that passed each level is put into passed and the
+ * number of trajectories and events are added to the totals.
+ */
+static double split_once(double age, const std::vector<int>& levels, int effort,
+	unsigned long seed, Random* pick, bool aggregate, bool frontier,
+	std::vector<double>& passed, SplitEstimate& totals)
+{
+	// States that passed the last level and the ages at which they did
+	std::vector<Patient*> states;
+	std::vector<double> when;
+	double p = 1.0;
+	for (unsigned s = 0; s < passed.size(); s++)
+	{
+		int level = (s < levels.size()) ? levels[s] : INT_MAX;
+		// Pick the states to copy before the trajectories are simulated
+		// so that the picks do not depend on the number of threads
+		std::vector<int> from(effort,0);
+		if (s > 0)
+			for (int n = 0; n < effort; n++)
+				from[n] = pick->uniform_int(states.size());
+		std::vector<Patient*> next(effort,NULL);
+		std::vector<double> next_when(effort,-1.0);
+		unsigned long events = 0;
+		#pragma omp parallel for schedule(dynamic,1) reduction(+:events)
+		for (int n = 0; n < effort; n++)
+		{
+			Patient* patient;
+			double start = 0.0;
+			if (s == 0)
+				patient = new Patient(seed+n,aggregate,frontier,true);
+			else
+			{
+				start = when[from[n]];
+				patient = new Patient(*(states[from[n]]),SPLIT_STREAM+s*effort+n,start);
+			}
+			next_when[n] = advance(*patient,start,age,level,events);
+			if (next_when[n] < 0.0)
+				delete patient;
+			else
+				next[n] = patient;
+		}
+		totals.trajectories += effort;
+		totals.events += events;
+		for (auto state : states)
+			delete state;
+		states.clear();
+		when.clear();
+		for (int n = 0; n < effort; n++)
+		{
+			if (next[n] == NULL)
+				continue;
+			states.push_back(next[n]);
+			when.push_back(next_when[n]);
+		}
+		passed[s] = (double)(states.size())/(double)(effort);
+		p *= passed[s];
+		// Nothing is left to copy
+		if (states.empty())
+			break;
+	}
+	for (auto state : states)
+		delete state;
+	return p;
+}
+
+SplitEstimate estimate_incidence(double age, const std::vector<int>& levels,
+	int effort, int replications, unsigned long first_seed,
+	bool aggregate, bool frontier)
+{
+	SplitEstimate e;
+	e.stages.assign(levels.size()+1,0.0);
+	e.trajectories = e.events = 0;
+	double sum = 0.0, sum_sq = 0.0;
+	// Make sure the singleton exists before the threads use it
+	Parameters::getInstance();
+	for (int r = 0; r < replications; r++)
+	{
+		Random pick(first_seed,RESAMPLE_STREAM+r);
+		std::vector<double> passed(levels.size()+1,0.0);
+		double p = split_once(age,levels,effort,first_seed+r*effort,&pick,
+			aggregate,frontier,passed,e);
+		sum += p;
+		sum_sq += p*p;
+		for (unsigned s = 0; s < passed.size(); s++)
+			e.stages[s] += passed[s]/replications;
+	}
+	e.p = sum/replications;
+	e.std_error = 0.0;
+	if (replications > 1)
+	{
+		double var = (sum_sq-sum*sum/replications)/(replications-1);
+		e.std_error = (var > 0.0) ? sqrt(var/replications) : 0.0;
+	}
+	return e;
+}
+
+void run_splitting(int effort, int replications, unsigned long first_seed,
+	const std::list<double>& biopsy, const std::vector<int>& levels,
+	const char* filename, bool aggregate, bool frontier)
+{
+	std::ofstream fout(filename);
+	fout << "age,estimate,std_error,ci_low,ci_high,trajectories,events,seconds,plain_patients";
+	for (auto level : levels)
+		fout << ",pass_" << level;
+	fout << ",pass_cancer" << std::endl;
+	for (auto age : biopsy)
+	{
+		auto start = std::chrono::steady_clock::now();
+		SplitEstimate e = estimate_incidence(age,levels,effort,replications,
+			first_seed,aggregate,frontier);
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+		double low = e.p-1.96*e.std_error, high = e.p+1.96*e.std_error;
+		// Patients that plain Monte Carlo needs for the same error
+		double plain = (e.std_error > 0.0) ? e.p*(1.0-e.p)/(e.std_error*e.std_error) : 0.0;
+		fout << age << "," << e.p << "," << e.std_error << "," <<
+			((low > 0.0) ? low : 0.0) << "," << high << "," <<
+			e.trajectories << "," << e.events << "," << secs << "," << plain;
+		for (auto pass : e.stages)
+			fout << "," << pass;
+		fout << std::endl;
+	}
+	fout.close();
+}
@@ -0,0 +1,68 @@
+#ifndef _splitting_h_
+#define _splitting_h_
+#include <list>
+#include <vector>
+#include "Patient.h"
+
+/**
+ * Trajectory n of stage s of a splitting estimate is a copy of a patient
+ * that uses this stream number plus s times the effort plus n of the
+ * patient's seed. Replication r picks the states to copy with stream
+ * RESAMPLE_STREAM plus r of the first seed.
+ */
+#define SPLIT_STREAM 0x40000000UL
+#define RESAMPLE_STREAM 0x20000000UL
+
+/**
+ * Estimate of the probability that a patient has cancer by some age.
+ */
+struct SplitEstimate
+{
+	double p; // Mean of the estimates made by the replications
+	double std_error; // Standard error of p
+	std::vector<double> stages; // Mean fraction of trajectories that passed each level
+	unsigned long trajectories; // Number of trajectories that were simulated
+	unsigned long events; // Events executed by the trajectories
+};
+
+/**
+ * Estimate the probability that a patient has cancer by the given age
+ * with fixed effort multilevel splitting. The levels are increasing
+ * numbers of DYSPLASIA and CANCER cells and the last level is any
+ * CANCER cell. Every level passes through the levels before it, so the
+ * probability is the product of the probability of passing each level
+ * given that the one before it was passed.
+ *
+ * The first stage simulates effort hybrid patients with seeds
+ * first_seed+n until they pass the first level or reach the age. Each
+ * later stage makes effort copies of states picked uniformly, with
+ * replacement, from those in which the stage before passed its level,
+ * and simulates the copies in the same way. A copy draws new clocks from
+ * its own stream, so copies of the same state have independent futures.
+ * The product of the fractions that passed each level is an unbiased
+ * estimate of the probability. A replication that has no trajectory
+ * pass a level estimates zero.
+ *
+ * The replications are independent and the standard error comes from
+ * their spread. Replication r uses the seeds from first_seed+r*effort.
+ * The trajectories of a stage are simulated in parallel and the result
+ * does not depend on the number of threads. The aggregate and frontier
+ * flags are passed to each Patient.
+ */
+SplitEstimate estimate_incidence(double age, const std::vector<int>& levels,
+	int effort, int replications, unsigned long first_seed,
+	bool aggregate, bool frontier);
+
+/**
+ * Estimate the incidence of cancer at each biopsy age and write one row
+ * for each to a CSV file. The row has the estimate, its standard error
+ * and 95% confidence interval, the number of trajectories and events
+ * that were used, the number of patients that plain Monte Carlo would
+ * need for the same standard error, and the mean fraction that passed
+ * each level.
+ */
+void run_splitting(int effort, int replications, unsigned long first_seed,
+	const std::list<double>& biopsy, const std::vector<int>& levels,
+	const char* filename, bool aggregate, bool frontier);
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef _summary_h_
+#define _summary_h_
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * Running estimate of a quantile by the P-square algorithm of Jain and
+ * Chlamtac (1985), The P2 algorithm for dynamic calculation of quantiles
+ * and histograms without storing observations. Five markers follow the
+ * minimum, the quantile, the maximum and the quantiles half way between
+ * them, and are moved by piecewise parabolic interpolation as values
+ * arrive. Memory is constant however many values are added. Up to five
+ * values the quantile is exact.
+ */
+class Quantile
+{
+	public:
+		/**
+		 * Estimate the quantile with probability p in (0,1).
+		 */
+		Quantile(double p):
+			p(p),n(0)
+		{
+			want[0] = 1.0; want[1] = 1.0+2.0*p; want[2] = 1.0+4.0*p;
+			want[3] = 3.0+2.0*p; want[4] = 5.0;
+			step[0] = 0.0; step[1] = p/2.0; step[2] = p;
+			step[3] = (1.0+p)/2.0; step[4] = 1.0;
+			for (int i = 0; i < 5; i++)
+				pos[i] = i+1;
+		}
+		/**
+		 * Add a value.
+		 */
+		void add(double x)
+		{
+			if (n < 5)
+			{
+				q[n++] = x;
+				std::sort(q,q+n);
+				return;
+			}
+			n++;
+			// Find the cell of the markers that holds x
+			int k;
+			if (x < q[0]) { q[0] = x; k = 0; }
+			else if (x >= q[4]) { q[4] = x; k = 3; }
+			else for (k = 0; x >= q[k+1]; k++);
+			for (int i = k+1; i < 5; i++)
+				pos[i]++;
+			for (int i = 0; i < 5; i++)
+				want[i] += step[i];
+			// Move the inner markers toward their desired positions
+			for (int i = 1; i < 4; i++)
+			{
+				double d = want[i]-pos[i];
+				if ((d >= 1.0 && pos[i+1]-pos[i] > 1) || (d <= -1.0 && pos[i-1]-pos[i] < -1))
+				{
+					int s = (d > 0.0) ? 1 : -1;
+					double qp = parabolic(i,s);
+					if (q[i-1] < qp && qp < q[i+1])
+						q[i] = qp;
+					else
+						q[i] += s*(q[i+s]-q[i])/(pos[i+s]-pos[i]);
+					pos[i] += s;
+				}
+			}
+		}
+		/**
+		 * The estimate of the quantile or zero if there are no values.
+		 */
+		double value() const
+		{
+			if (n == 0)
+				return 0.0;
+			if (n <= 5)
+				return q[(int)(p*(n-1)+0.5)];
+			return q[2];
+		}
+	private:
+		double p; // Probability of the quantile
+		unsigned long n; // Number of values
+		double q[5]; // Heights of the markers or the first values
+		long pos[5]; // Positions of the markers
+		double want[5]; // Desired positions of the markers
+		double step[5]; // Increments of the desired positions
+		/// Parabolic prediction of marker i moved by s
+		double parabolic(int i, int s) const
+		{
+			return q[i]+(double)s/(pos[i+1]-pos[i-1])*
+				((pos[i]-pos[i-1]+s)*(q[i+1]-q[i])/(pos[i+1]-pos[i])+
+				 (pos[i+1]-pos[i]-s)*(q[i]-q[i-1])/(pos[i]-pos[i-1]));
+		}
+};
+
+/**
+ * Summary statistics of a stream of values. The mean and variance are
+ * updated by the method of Welford (1962) and the 5%, 50% and 95%
+ * quantiles by the P-square algorithm, so the memory needed does not
+ * grow with the number of values. The same values added in the same
+ * order give the same summary.
+ */
+class Summary
+{
+	public:
+		Summary():
+			n(0),avg(0.0),m2(0.0),
+			lo(std::numeric_limits<double>::infinity()),
+			hi(-std::numeric_limits<double>::infinity()),
+			p05(0.05),p50(0.5),p95(0.95)
+		{
+		}
+		/**
+		 * Add a value.
+		 */
+		void add(double x)
+		{
+			n++;
+			double d = x-avg;
+			avg += d/n;
+			m2 += d*(x-avg);
+			if (x < lo) lo = x;
+			if (x > hi) hi = x;
+			p05.add(x);
+			p50.add(x);
+			p95.add(x);
+		}
+		/**
+		 * Number of values that were added.
+		 */
+		unsigned long count() const { return n; }
+		/**
+		 * Mean of the values or zero if there are none.
+		 */
+		double mean() const { return avg; }
+		/**
+		 * Sample standard deviation of the values or zero if there are
+		 * fewer than two.
+		 */
+		double std_dev() const { return (n > 1) ? sqrt(m2/(n-1)) : 0.0; }
+		/**
+		 * Smallest and largest values or zero if there are none.
+		 */
+		double min() const { return (n > 0) ? lo : 0.0; }
+		double max() const { return (n > 0) ? hi : 0.0; }
+		/**
+		 * Estimates of the 5%, 50% and 95% quantiles.
+		 */
+		double q5() const { return p05.value(); }
+		double median() const { return p50.value(); }
+		double q95() const { return p95.value(); }
+	private:
+		unsigned long n; // Number of values
+		double avg, m2; // Mean and sum of squared deviations from it
+		double lo, hi; // Smallest and largest value
+		Quantile p05, p50, p95; // 5%, 50% and 95% quantiles
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "Sweep.h"
+#include "Patient.h"
+#include "Summary.h"
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// Runs simulated in parallel before their outcomes are summarized
+static const long block_size = 1024;
+
+/**
+ * Value of a factor at fraction u of its range.
+ */
+static double factor_value(const Factor& f, double u)
+{
+	if (f.log_scale)
+		return exp(log(f.low)+u*(log(f.high)-log(f.low)));
+	return f.low+u*(f.high-f.low);
+}
+
+Design factorial_design(const std::vector<Factor>& factors, int levels)
+{
+	Design design;
+	long rows = 1;
+	for (auto f : factors)
+	{
+		design.names.push_back(f.name);
+		rows *= levels;
+	}
+	for (long n = 0; n < rows; n++)
+	{
+		std::vector<double> row(factors.size());
+		long index = n;
+		for (int j = factors.size()-1; j >= 0; j--)
+		{
+			int level = index%levels;
+			index /= levels;
+			row[j] = factor_value(factors[j],(levels > 1) ? (double)level/(levels-1) : 0.0);
+		}
+		design.rows.push_back(row);
+	}
+	return design;
+}
+
+Design latin_hypercube(const std::vector<Factor>& factors, int rows,
+	unsigned long seed)
+{
+	Design design;
+	Random rng(seed,DESIGN_STREAM);
+	design.rows.assign(rows,std::vector<double>(factors.size()));
+	for (unsigned j = 0; j < factors.size(); j++)
+	{
+		design.names.push_back(factors[j].name);
+		// Shuffle the strata and put one row in each
+		std::vector<int> strata(rows);
+		for (int n = 0; n < rows; n++)
+			strata[n] = n;
+		for (int n = rows-1; n > 0; n--)
+			std::swap(strata[n],strata[rng.uniform_int(n+1)]);
+		for (int n = 0; n < rows; n++)
+			design.rows[n][j] = factor_value(factors[j],(strata[n]+rng.uniform())/rows);
+	}
+	return design;
+}
+
+bool read_design(const char* filename, Design& design, std::string& error)
+{
+	std::ifstream fin(filename);
+	std::string line, field;
+	if (!fin.good() || !getline(fin,line))
+	{
+		error = std::string("Could not read design ")+filename;
+		return false;
+	}
+	// Names of the columns must be parameters
+	Parameters check;
+	std::istringstream header(line);
+	design.names.clear();
+	design.rows.clear();
+	while (getline(header,field,','))
+	{
+		if (!check.set(field,0.0))
+		{
+			error = "Unknown parameter "+field+" in design "+filename;
+			return false;
+		}
+		design.names.push_back(field);
+	}
+	while (getline(fin,line))
+	{
+		if (line.empty())
+			continue;
+		std::istringstream sin(line);
+		std::vector<double> row;
+		while (getline(sin,field,','))
+			row.push_back(atof(field.c_str()));
+		if (row.size() != design.names.size())
+		{
+			std::ostringstream msg;
+			msg << "Row " << design.rows.size()+1 << " of design " << filename <<
+				" has " << row.size() << " values instead of " << design.names.size();
+			error = msg.str();
+			return false;
+		}
+		design.rows.push_back(row);
+	}
+	return true;
+}
+
+/**
+ * Parameters for a row of the design. These are the values applied to
+ * the singleton with those of the row in place of its own.
+ */
+static Parameters* row_parameters(const Design& design, long row, std::string& error)
+{
+	const Parameters* base = Parameters::getInstance();
+	Parameters* p = new Parameters();
+	for (auto& v : base->applied())
+		p->set(v.first,v.second);
+	for (unsigned j = 0; j < design.names.size(); j++)
+		p->set(design.names[j],design.rows[row][j]);
+	p->pooled_random(base->pooled_random());
+	if (!p->apply(error))
+	{
+		delete p;
+		return NULL;
+	}
+	return p;
+}
+
+void largest_grid(const Design& design, int& nx, int& ny, int& nz)
+{
+	const Parameters* base = Parameters::getInstance();
+	nx = base->xdim();
+	ny = base->ydim();
+	nz = base->zdim();
+	for (long row = 0; row < (long)design.rows.size(); row++)
+	{
+		std::string error;
+		Parameters* p = row_parameters(design,row,error);
+		if (p == NULL)
+			continue;
+		if ((double)p->xdim()*p->ydim()*p->zdim() > (double)nx*ny*nz)
+		{
+			nx = p->xdim();
+			ny = p->ydim();
+			nz = p->zdim();
+		}
+		delete p;
+	}
+}
+
+/**
+ * Simulate a patient to each age and record the age of the first
+ * DYSPLASIA and CANCER cells, or a negative number if there was none,
+ * followed by the count of each type at each age. The patient is stepped
+ * one event at a time only until both have appeared.
+ */
+static void follow_outcomes(Patient& patient, const std::vector<double>& ages,
+	std::vector<double>& outcome)
+{
+	int types[NUM_CELL_TYPES];
+	double first_dysplasia = -1.0, first_cancer = -1.0;
+	outcome.resize(2+ages.size()*NUM_CELL_TYPES);
+	for (unsigned a = 0; a < ages.size(); a++)
+	{
+		while (first_cancer < 0.0 && patient.next_event() <= ages[a])
+		{
+			double t = patient.next_event();
+			patient.step();
+			patient.count(types);
+			if (first_dysplasia < 0.0 && types[DYSPLASIA]+types[CANCER] > 0)
+				first_dysplasia = t;
+			if (types[CANCER] > 0)
+				first_cancer = t;
+		}
+		patient.run_to(ages[a]);
+		patient.count(types);
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			outcome[2+a*NUM_CELL_TYPES+i] = types[i];
+	}
+	outcome[0] = first_dysplasia;
+	outcome[1] = first_cancer;
+}
+
+/**
+ * Write the summary of one outcome of a row.
+ */
+static void write_summary(std::ofstream& fout, const Design& design, long row,
+	const std::string& outcome, const Summary& s)
+{
+	fout << row+1;
+	for (auto v : design.rows[row])
+		fout << "," << v;
+	fout << "," << outcome << "," << s.count() << "," << s.mean() << "," <<
+		s.std_dev() << "," << s.min() << "," << s.q5() << "," << s.median() <<
+		"," << s.q95() << "," << s.max() << "\n";
+}
+
+void run_sweep(const Design& design, int replicates, unsigned long first_seed,
+	const std::list<double>& biopsy, const char* filename,
+	bool aggregate, bool frontier, bool hybrid)
+{
+	const std::vector<double> ages(biopsy.begin(),biopsy.end());
+	const long rows = design.rows.size();
+	// Check every row before simulating any of them
+	for (long row = 0; row < rows; row++)
+	{
+		std::string error;
+		Parameters* p = row_parameters(design,row,error);
+		if (p == NULL)
+		{
+			std::cout << "Row " << row+1 << " of the design: " << error << std::endl;
+			exit(0);
+		}
+		delete p;
+	}
+	std::ofstream fout(filename);
+	fout << "row";
+	for (auto name : design.names)
+		fout << "," << name;
+	fout << ",outcome,runs,mean,std_dev,min,q05,median,q95,max" << std::endl;
+	// Names of the outcomes after the first ages
+	std::vector<std::string> names;
+	for (auto age : ages)
+	{
+		std::ostringstream suffix;
+		suffix << "_" << age;
+		names.push_back("dysplasia"+suffix.str());
+		names.push_back("cancer"+suffix.str());
+		names.push_back("volume"+suffix.str());
+	}
+	std::vector<Summary> summary(2+names.size());
+	const long runs = rows*replicates;
+	std::vector<std::vector<double> > outcome(block_size);
+	std::vector<Parameters*> params;
+	for (long first = 0; first < runs; first += block_size)
+	{
+		const long count = (runs-first < block_size) ? runs-first : block_size;
+		const long first_row = first/replicates;
+		for (long row = first_row; row <= (first+count-1)/replicates; row++)
+		{
+			std::string error;
+			params.push_back(row_parameters(design,row,error));
+		}
+		#pragma omp parallel for schedule(dynamic,1)
+		for (long k = 0; k < count; k++)
+		{
+			long row = (first+k)/replicates;
+			Parameters::Scope scope(params[row-first_row]);
+			Patient patient(first_seed+(first+k)%replicates,aggregate,frontier,hybrid);
+			follow_outcomes(patient,ages,outcome[k]);
+		}
+		// Add the outcomes in order and write each row as it finishes
+		for (long k = 0; k < count; k++)
+		{
+			const std::vector<double>& o = outcome[k];
+			long row = (first+k)/replicates;
+			for (int i = 0; i < 2; i++)
+				if (o[i] >= 0.0)
+					summary[i].add(o[i]);
+			// The grid size might be a factor
+			const double volume = pow(params[row-first_row]->cell_size(),3.0);
+			for (unsigned a = 0; a < ages.size(); a++)
+			{
+				const double* types = &(o[2+a*NUM_CELL_TYPES]);
+				summary[2+3*a].add(types[DYSPLASIA]);
+				summary[3+3*a].add(types[CANCER]);
+				summary[4+3*a].add((types[DYSPLASIA]+types[CANCER])*volume);
+			}
+			if ((first+k)%replicates != replicates-1)
+				continue;
+			write_summary(fout,design,row,"first_dysplasia",summary[0]);
+			write_summary(fout,design,row,"first_cancer",summary[1]);
+			for (unsigned i = 0; i < names.size(); i++)
+				write_summary(fout,design,row,names[i],summary[2+i]);
+			summary.assign(summary.size(),Summary());
+		}
+		for (auto p : params)
+			delete p;
+		params.clear();
+	}
+	fout.close();
+}
@@ -0,0 +1,96 @@
+#ifndef _sweep_h_
+#define _sweep_h_
+#include <list>
+#include <string>
+#include <vector>
+
+/**
+ * A Latin hypercube for the seed of a sweep uses this stream number of
+ * the seed.
+ */
+#define DESIGN_STREAM 0x10000000UL
+
+/**
+ * A parameter that a sweep varies and the range of its values. On a log
+ * scale the values are spread evenly in the log of the parameter, which
+ * suits rates that span orders of magnitude.
+ */
+struct Factor
+{
+	std::string name; // Name in the input file
+	double low, high; // Range of the values
+	bool log_scale; // Spread the values evenly in log(value)?
+};
+
+/**
+ * A design matrix. Column j of every row is the value of the parameter
+ * names[j]. The other parameters keep the values from the input file.
+ */
+struct Design
+{
+	std::vector<std::string> names;
+	std::vector<std::vector<double> > rows;
+};
+
+/**
+ * Make a full factorial design with the given number of levels for each
+ * factor, evenly spaced from low to high. The last factor varies
+ * fastest.
+ */
+Design factorial_design(const std::vector<Factor>& factors, int levels);
+
+/**
+ * Make a Latin hypercube design with the given number of rows. The
+ * range of each factor is cut into that many strata of equal width
+ * and each stratum is used by exactly one row, at a point drawn
+ * uniformly within it. The pairing of strata across factors is random.
+ * The random numbers come from stream DESIGN_STREAM of the seed.
+ */
+Design latin_hypercube(const std::vector<Factor>& factors, int rows,
+	unsigned long seed);
+
+/**
+ * Read a design from a CSV file. The first line has the names of the
+ * parameters and each line after it is a row of values. Returns false
+ * and puts the reason into error if the file cannot be read or has an
+ * unknown name or a short row.
+ */
+bool read_design(const char* filename, Design& design, std::string& error);
+
+/**
+ * Find the dimensions of the largest grid, by number of grid points,
+ * among the rows of a design. The dimensions start as those of the
+ * Parameters singleton and are replaced by those of any row with a
+ * larger grid. Rows that are not valid are skipped.
+ */
+void largest_grid(const Design& design, int& nx, int& ny, int& nz);
+
+/**
+ * Simulate every row of a design with the given number of replicates
+ * and write a summary of the outcomes of each row to a CSV file. Rows
+ * are numbered from one.
+ * Replicate r of every row is a patient with the seed first_seed+r, so
+ * the rows are compared with common random numbers. The other
+ * parameters come from the Parameters singleton and each row is checked
+ * before any are simulated. Exits if a row is not valid. The aggregate,
+ * frontier and hybrid flags are passed to each Patient.
+ *
+ * The outcomes of a run are the ages at which the first DYSPLASIA and
+ * CANCER cells appear, and the number of DYSPLASIA and CANCER cells and
+ * their volume in cubic mm at each biopsy age. Each outcome of a row is
+ * summarized by the number of runs that had it, its mean, standard
+ * deviation, minimum, 5%, 50% and 95% quantiles and maximum. A run
+ * with no DYSPLASIA or CANCER by the last age is left out of the
+ * summary of that first age.
+ *
+ * The runs of every row are simulated in parallel, in blocks whose
+ * outcomes are added to the summaries in order of row and replicate, so
+ * the results do not depend on the number of threads. Only the summaries
+ * of the current row are kept, so memory does not grow with the number
+ * of runs.
+ */
+void run_sweep(const Design& design, int replicates, unsigned long first_seed,
+	const std::list<double>& biopsy, const char* filename,
+	bool aggregate, bool frontier, bool hybrid);
+
+#endif
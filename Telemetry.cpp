@@ -0,0 +1,106 @@
+#include "Telemetry.h"
+#include "Memory.h"
+#ifdef TELEMETRY
+#include <mutex>
+
+namespace telemetry
+{
+
+static Counters* threads = NULL; // Every thread's block of counters
+static std::mutex threads_lock;
+
+Counters* add_thread()
+{
+	Counters* c = new Counters();
+	std::lock_guard<std::mutex> guard(threads_lock);
+	c->next = threads;
+	threads = c;
+	return c;
+}
+
+Counters total()
+{
+	Counters sum = Counters();
+	std::lock_guard<std::mutex> guard(threads_lock);
+	for (Counters* c = threads; c != NULL; c = c->next)
+	{
+		for (int k = 0; k < NUM_EVENT_KINDS; k++)
+			for (int i = 0; i < NUM_CELL_TYPES; i++)
+				sum.events[k][i] += c->events[k][i];
+		sum.ticks += c->ticks;
+		sum.samples += c->samples;
+		sum.sample_secs += c->sample_secs;
+	}
+	return sum;
+}
+
+const char* kind_name(int kind)
+{
+	static const char* names[NUM_EVENT_KINDS] = {
+		"mutate", "expand", "off_grid", "no_op", "confluent" };
+	return names[kind];
+}
+
+const char* type_name(int iType)
+{
+	static const char* names[NUM_CELL_TYPES] = {
+		"normal", "BE", "dysplasia", "cancer" };
+	return names[iType];
+}
+
+void write_header(std::ostream& out)
+{
+	out << "age,seconds,events,events_per_sec,ns_per_event,queue,rss_kb,peak_rss_kb";
+	for (int k = 0; k < NUM_EVENT_KINDS; k++)
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			out << "," << kind_name(k) << "_" << type_name(i);
+	out << std::endl;
+}
+
+void write_row(std::ostream& out, double age, double secs, long queue)
+{
+	Counters c = total();
+	long rss, peak;
+	process_memory(rss,peak);
+	out << age << "," << secs << "," << c.ticks << "," <<
+		((secs > 0.0) ? c.ticks/secs : 0.0) << "," <<
+		((c.samples > 0) ? 1E9*c.sample_secs/c.samples : 0.0) << ",";
+	if (queue >= 0)
+		out << queue;
+	out << "," << rss << "," << peak;
+	for (int k = 0; k < NUM_EVENT_KINDS; k++)
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			out << "," << c.events[k][i];
+	out << std::endl;
+}
+
+void write_json(std::ostream& out, double age, double secs, long queue)
+{
+	Counters c = total();
+	long rss, peak;
+	process_memory(rss,peak);
+	out << "{\n";
+	out << "  \"age\": " << age << ",\n";
+	out << "  \"seconds\": " << secs << ",\n";
+	out << "  \"events\": " << c.ticks << ",\n";
+	out << "  \"events_per_sec\": " << ((secs > 0.0) ? c.ticks/secs : 0.0) << ",\n";
+	out << "  \"ns_per_event\": " <<
+		((c.samples > 0) ? 1E9*c.sample_secs/c.samples : 0.0) << ",\n";
+	if (queue >= 0)
+		out << "  \"queue\": " << queue << ",\n";
+	out << "  \"rss_kb\": " << rss << ",\n";
+	out << "  \"peak_rss_kb\": " << peak << ",\n";
+	out << "  \"counts\": {";
+	for (int k = 0; k < NUM_EVENT_KINDS; k++)
+	{
+		out << ((k == 0) ? "\n" : ",\n") << "    \"" << kind_name(k) << "\": {";
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			out << ((i == 0) ? " " : ", ") << "\"" << type_name(i) << "\": " << c.events[k][i];
+		out << " }";
+	}
+	out << "\n  }\n}" << std::endl;
+}
+
+}
+
+#endif
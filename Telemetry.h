@@ -0,0 +1,142 @@
+#ifndef _telemetry_h_
+#define _telemetry_h_
+#include "common.h"
+
+/**
+ * Kinds of events that are counted by the telemetry. The counts are
+ * broken down by the type of the cell that the event happens to.
+ *
+ * MUTATE_EVENT: A cell mutates into the next type.
+ * EXPAND_EVENT: A dysplasia or cancer cell tries to expand.
+ * OFF_GRID_EVENT: An expansion leaves the grid and is dropped.
+ * NO_OP_EVENT: An expansion or a pooled mutation reaches a cell that it
+ *	cannot change.
+ * CONFLUENT_EVENT: An adevs volume has an internal and an external
+ *	event at the same time.
+ */
+#define MUTATE_EVENT 0
+#define EXPAND_EVENT 1
+#define OFF_GRID_EVENT 2
+#define NO_OP_EVENT 3
+#define CONFLUENT_EVENT 4
+#define NUM_EVENT_KINDS 5
+
+/**
+ * The telemetry is compiled in only if TELEMETRY is defined, e.g. by
+ * make OPTFLAG=-DTELEMETRY. Otherwise the macros below are empty and
+ * cost nothing.
+ *
+ * Each thread counts into its own block of counters, so the engines do
+ * not share anything in the hot path. The blocks are summed when the
+ * telemetry is read, which should be done while no events are being
+ * executed. Events in windows that the ParallelTissue rolls back are
+ * counted, because they cost time like any other. One event in every
+ * TELEMETRY_SAMPLE is timed to estimate the cost of an event without
+ * reading the clock for each one.
+ */
+#ifdef TELEMETRY
+#include <chrono>
+#include <iostream>
+
+#define TELEMETRY_SAMPLE 64
+
+namespace telemetry
+{
+
+struct Counters
+{
+	unsigned long events[NUM_EVENT_KINDS][NUM_CELL_TYPES];
+	unsigned long ticks; // Events seen by the sampled timer
+	unsigned long samples; // Events that were timed
+	double sample_secs; // Seconds spent in the timed events
+	Counters* next; // Next block in the list of every thread's blocks
+};
+
+/**
+ * Create and register a block of counters for the calling thread.
+ */
+Counters* add_thread();
+
+/**
+ * Get the counters of the calling thread.
+ */
+inline Counters& local()
+{
+	static thread_local Counters* mine = NULL;
+	if (mine == NULL)
+		mine = add_thread();
+	return *mine;
+}
+
+inline void count(int kind, int iType)
+{
+	local().events[kind][iType]++;
+}
+
+/**
+ * Times the event executed in its scope if it is one of the sampled
+ * events.
+ */
+class EventTimer
+{
+	public:
+		EventTimer():
+			c(local()),
+			sampled(++c.ticks % TELEMETRY_SAMPLE == 0)
+		{
+			if (sampled)
+				start = std::chrono::steady_clock::now();
+		}
+		~EventTimer()
+		{
+			if (!sampled)
+				return;
+			c.samples++;
+			c.sample_secs += std::chrono::duration<double>(
+				std::chrono::steady_clock::now()-start).count();
+		}
+	private:
+		Counters& c;
+		const bool sampled;
+		std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * The sum of the counters of every thread.
+ */
+Counters total();
+
+/**
+ * Name of an event kind and of a cell type for use in column names.
+ */
+const char* kind_name(int kind);
+const char* type_name(int iType);
+
+/**
+ * Write the header of the CSV file and then a row with the telemetry at
+ * the given age. Secs is the time since the simulation started and
+ * queue is the number of cells with pending events, or negative if the
+ * engine does not know it. The events are those seen by the sampled
+ * timer, which is every event that was executed.
+ */
+void write_header(std::ostream& out);
+void write_row(std::ostream& out, double age, double secs, long queue);
+
+/**
+ * Write the same values as one JSON object.
+ */
+void write_json(std::ostream& out, double age, double secs, long queue);
+
+}
+
+#define TELEMETRY_COUNT(kind,iType) telemetry::count(kind,iType)
+#define TELEMETRY_TIME_EVENT() telemetry::EventTimer _event_timer
+
+#else
+
+#define TELEMETRY_COUNT(kind,iType) ((void)0)
+#define TELEMETRY_TIME_EVENT() ((void)0)
+
+#endif
+
+#endif
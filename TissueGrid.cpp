@@ -0,0 +1,415 @@
+#include "TissueGrid.h"
+#include "Checkpoint.h"
+#include "Telemetry.h"
+#include <algorithm>
+
+TissueGrid::TissueGrid(int nx, int ny, int nz, Random* rng, int x0, int y0):
+	nx(nx),ny(ny),nz(nz),
+	x0(x0),y0(y0),
+	p(Parameters::getInstance()),
+	rng((rng == NULL) ? p->random() : rng),
+	cells(nx*ny*nz,NORMAL),
+	stored_rows(ny),
+	margin(-1),
+	pop(nx,ny,nz),
+	frontier(false),
+	pool_be(false),
+	pool_size(0),
+	t_pool(-1.0),
+	next_in(0),
+	observer(NULL),
+	recording(false)
+{
+}
+
+void TissueGrid::incoming(const std::vector<Expansion>& xb)
+{
+	inbox = xb;
+	std::sort(inbox.begin(),inbox.end());
+	next_in = 0;
+}
+
+void TissueGrid::mark()
+{
+	assert(margin < 0);
+	recording = true;
+	undo.clear();
+	steps.clear();
+	old_pools.clear();
+}
+
+unsigned long TissueGrid::rollback(double t, const std::vector<Expansion>& xb)
+{
+	assert(recording);
+	// Find the first event at or after t
+	unsigned first = steps.size();
+	while (first > 0 && steps[first-1].t >= t)
+		first--;
+	unsigned long undone = steps.size()-first;
+	if (undone > 0)
+	{
+		const Step& step = steps[first];
+		// Put back the cells in the reverse of the order they changed,
+		// which also leaves the census in its prior order
+		while (undo.size() > step.undone)
+		{
+			const Undo& u = undo.back();
+			pop.change(u.cell,cells[u.cell],u.iType);
+			cells[u.cell] = u.iType;
+			if (u.queued)
+				schedule.set(u.cell,u.tm,u.te);
+			else
+				schedule.remove(u.cell);
+			undo.pop_back();
+		}
+		while (old_pools.size() > step.pools)
+		{
+			pool.swap(old_pools.back());
+			old_pools.pop_back();
+		}
+		outbox.resize(step.sent);
+		pool_size = step.pool_size;
+		t_pool = step.t_pool;
+		*rng = step.rng;
+		steps.resize(first);
+	}
+	inbox = xb;
+	std::sort(inbox.begin(),inbox.end());
+	next_in = 0;
+	while (next_in < inbox.size() && inbox[next_in].t < t)
+		next_in++;
+	return undone;
+}
+
+void TissueGrid::region_of_interest(int margin)
+{
+	assert(margin >= 1 && x0 == 0 && y0 == 0 && pop.non_normal().empty());
+	this->margin = margin;
+	stored_rows = 0;
+	std::vector<unsigned char>().swap(cells);
+}
+
+void TissueGrid::store_rows(int y)
+{
+	int needed = y+1+margin;
+	if (needed > ny) needed = ny;
+	if (needed <= stored_rows)
+		return;
+	// y varies slowest, so new rows go at the end and no cell moves
+	stored_rows = needed;
+	cells.resize(stored_rows*nz*nx,NORMAL);
+}
+
+void TissueGrid::add(int iType, int x, int y, int z)
+{
+	if (margin >= 0)
+		store_rows(y);
+	int cell = index(x,y,z);
+	set_type(cell,iType,0.0);
+	// Frontier rates need the neighbors in the rest of the space
+	assert(!frontier || (nx == p->xdim() && ny == p->ydim()));
+	// Pooled BE cells do not get their own clock
+	if (pool_be && iType == BE &&
+			p->get_mutation_interval(BE) < adevs_inf<double>())
+	{
+		pool.push_back(cell);
+		pool_size++;
+		t_pool = -1.0;
+	}
+	else changed(cell,0.0);
+}
+
+void TissueGrid::redraw(double t)
+{
+	std::vector<EventQueue::Entry> active(schedule.entries());
+	for (auto e : active)
+		reset(e.cell,t);
+	if (!pool.empty())
+		t_pool = t+rng->exponential(p->get_mutation_interval(BE)/pool.size());
+}
+
+void TissueGrid::save(std::ostream& out) const
+{
+	assert(x0 == 0 && y0 == 0 && outbox.empty() && next_in == inbox.size());
+	save_value(out,nx);
+	save_value(out,ny);
+	save_value(out,nz);
+	save_value(out,frontier);
+	save_value(out,pool_be);
+	save_value(out,pool_size);
+	save_value(out,t_pool);
+	save_value(out,margin);
+	save_vector(out,cells);
+	save_vector(out,pool);
+	save_vector(out,schedule.entries());
+}
+
+bool TissueGrid::load(std::istream& in)
+{
+	int dims[3];
+	std::vector<EventQueue::Entry> active;
+	if (!load_value(in,dims) || dims[0] != nx || dims[1] != ny || dims[2] != nz)
+		return false;
+	if (!load_value(in,frontier) || !load_value(in,pool_be) ||
+		!load_value(in,pool_size) || !load_value(in,t_pool) ||
+		!load_value(in,margin) ||
+		!load_vector(in,cells) || !load_vector(in,pool) ||
+		!load_vector(in,active) || cells.size()%(nx*nz) != 0 ||
+		cells.size() > (unsigned)(nx*ny*nz))
+		return false;
+	stored_rows = cells.size()/(nx*nz);
+	// The census is rebuilt from the cells
+	pop = Census(nx,ny,nz);
+	for (unsigned cell = 0; cell < cells.size(); cell++)
+		pop.change(cell,NORMAL,cells[cell]);
+	// Entries in heap order rebuild the same heap
+	schedule.clear();
+	for (auto e : active)
+		schedule.set(e.cell,e.tm,e.te);
+	outbox.clear();
+	inbox.clear();
+	next_in = 0;
+	return true;
+}
+
+double TissueGrid::pool_time() const
+{
+	if (pool.empty())
+		return adevs_inf<double>();
+	// Draw the time to the next event using the summed rate of the pool.
+	// Cells are only added at time zero.
+	if (t_pool < 0.0)
+		t_pool = rng->exponential(p->get_mutation_interval(BE)/pool.size());
+	return t_pool;
+}
+
+void TissueGrid::pool_event(double t)
+{
+	// Pick a cell uniformly. If it has been invaded since the pool was
+	// built then its mutation is simply discarded.
+	int cell = pool[rng->uniform_int(pool.size())];
+	if (cells[cell] == BE)
+	{
+		TELEMETRY_COUNT(MUTATE_EVENT,BE);
+		pool_size--;
+		set_type(cell,ModelRules::mutates_to(BE),t);
+		changed(cell,t);
+	}
+	else
+		TELEMETRY_COUNT(NO_OP_EVENT,cells[cell]);
+	// Rebuild the pool when half of it is no longer BE. The count is
+	// also decremented when BE cells that are not in the pool (e.g.
+	// those mutated from NORMAL) are invaded, so it is recounted here.
+	if (2*pool_size < (int)pool.size())
+	{
+		std::vector<int> still_be;
+		still_be.reserve(pool.size());
+		for (auto c : pool)
+			if (cells[c] == BE) still_be.push_back(c);
+		if (recording)
+			old_pools.push_back(pool);
+		pool.swap(still_be);
+		pool_size = pool.size();
+	}
+	// The pool is memoryless so we can draw the next event from now
+	t_pool = (pool.empty()) ? adevs_inf<double>() :
+		t+rng->exponential(p->get_mutation_interval(BE)/pool.size());
+}
+
+double TissueGrid::nextEventTime() const
+{
+	double t = pool_time();
+	if (!schedule.empty() && schedule.top().t() < t)
+		t = schedule.top().t();
+	if (incoming_time() < t)
+		t = incoming_time();
+	return t;
+}
+
+unsigned long TissueGrid::execUntil(double tstop)
+{
+	unsigned long count = 0;
+	while (nextEventTime() <= tstop)
+	{
+		TELEMETRY_TIME_EVENT();
+		execNextEvent();
+		count++;
+	}
+	return count;
+}
+
+void TissueGrid::execNextEvent()
+{
+	if (recording)
+	{
+		Step step;
+		step.t = nextEventTime();
+		step.undone = undo.size();
+		step.sent = outbox.size();
+		step.pools = old_pools.size();
+		step.pool_size = pool_size;
+		step.t_pool = t_pool;
+		step.rng = *rng;
+		steps.push_back(step);
+	}
+	double t_sched = (schedule.empty()) ? adevs_inf<double>() : schedule.top().t();
+	// Expansion from another part of the space
+	if (incoming_time() < adevs_inf<double>() &&
+			incoming_time() <= t_sched && incoming_time() <= pool_time())
+	{
+		const Expansion& xb = inbox[next_in++];
+		invade(index(xb.x-x0,xb.y-y0,xb.z),xb.iType,xb.t);
+		return;
+	}
+	// Mutation from the BE pool
+	if (pool_time() < adevs_inf<double>() && pool_time() <= t_sched)
+	{
+		pool_event(pool_time());
+		return;
+	}
+	if (schedule.empty())
+		return;
+	const EventQueue::Entry tv = schedule.top();
+	const int cell = tv.cell;
+	const double t = tv.t();
+	int iType = cells[cell];
+	// We will mutate
+	if (tv.tm < tv.te)
+	{
+		// Only types that mutate into another have a mutation clock
+		assert(ModelRules::mutates_to(iType) != iType);
+		TELEMETRY_COUNT(MUTATE_EVENT,iType);
+		// Evolve our type and pick new times to mutate and expand
+		set_type(cell,ModelRules::mutates_to(iType),t);
+		changed(cell,t);
+	}
+	// Expand into one of the neighbors that we can change. This will
+	// update our own time to expand.
+	else if (frontier)
+	{
+		int target[ModelRules::MAX_STENCIL];
+		int s = susceptible(cell,target);
+		assert(s > 0);
+		TELEMETRY_COUNT(EXPAND_EVENT,iType);
+		invade(target[rng->uniform_int(s)],iType,t);
+	}
+	// If not mutating, then we are moving
+	else
+	{
+		assert(ModelRules::can_expand(iType));
+		TELEMETRY_COUNT(EXPAND_EVENT,iType);
+		int x = cell%nx+x0, z = (cell/nx)%nz, y = cell/(nx*nz)+y0;
+		// Each type spreads in the directions of its own stencil
+		const int* d = ModelRules::offset(rng->direction(ModelRules::stencil_size(iType)));
+		x += d[0]; y += d[1]; z += d[2];
+		// Set time to next expansion
+		record(cell);
+		schedule.set(cell,tv.tm,t+rng->exponential(p->get_expand_interval()));
+		// If direction is out of the space, then nothing happens
+		if (!p->wrap(x,y,z))
+		{
+			TELEMETRY_COUNT(OFF_GRID_EVENT,iType);
+			return;
+		}
+		// Invade our own cell or send the expansion to another grid
+		if (x >= x0 && x < x0+nx && y >= y0 && y < y0+ny)
+			invade(index(x-x0,y-y0,z),iType,t);
+		else
+		{
+			Expansion yb;
+			yb.t = t; yb.x = x; yb.y = y; yb.z = z; yb.iType = iType;
+			outbox.push_back(yb);
+		}
+	}
+}
+
+void TissueGrid::invade(int cell, int iType, double t)
+{
+	int oldType = cells[cell];
+	// Same rule as TissueVolume::delta_ext
+	if (ModelRules::can_invade(iType,oldType,(cell/nx)%nz))
+	{
+		if (oldType == BE && !pool.empty())
+			pool_size--;
+		set_type(cell,iType,t);
+		changed(cell,t);
+	}
+	else
+		TELEMETRY_COUNT(NO_OP_EVENT,oldType);
+}
+
+void TissueGrid::changed(int cell, double t)
+{
+	reset(cell,t);
+	if (!frontier)
+		return;
+	// The neighbors that can expand into us have new rates
+	int x = cell%nx, z = (cell/nx)%nz, y = cell/(nx*nz);
+	for (int d = 0; d < ModelRules::MAX_STENCIL; d++)
+	{
+		const int* o = ModelRules::offset(d);
+		int xx = x+o[0], yy = y+o[1], zz = z+o[2];
+		if (!p->wrap(xx,yy,zz))
+			continue;
+		int other = index(xx,yy,zz);
+		if (!ModelRules::can_expand(cells[other]))
+			continue;
+		const EventQueue::Entry* e = schedule.find(other);
+		double tm = (e == NULL) ? adevs_inf<double>() : e->tm;
+		double te = expand_time(other,t);
+		record(other);
+		if (tm == adevs_inf<double>() && te == adevs_inf<double>())
+			schedule.remove(other);
+		else
+			schedule.set(other,tm,te);
+	}
+}
+
+int TissueGrid::susceptible(int cell, int* target) const
+{
+	int iType = cells[cell];
+	int x = cell%nx, z = (cell/nx)%nz, y = cell/(nx*nz);
+	int dirs = ModelRules::stencil_size(iType), s = 0;
+	for (int d = 0; d < dirs; d++)
+	{
+		const int* o = ModelRules::offset(d);
+		int xx = x+o[0], yy = y+o[1], zz = z+o[2];
+		if (p->wrap(xx,yy,zz) && ModelRules::can_invade(iType,cells[index(xx,yy,zz)],zz))
+		{
+			if (target != NULL) target[s] = index(xx,yy,zz);
+			s++;
+		}
+	}
+	return s;
+}
+
+double TissueGrid::expand_time(int cell, double t)
+{
+	int iType = cells[cell];
+	if (!ModelRules::can_expand(iType))
+		return adevs_inf<double>();
+	if (!frontier)
+		return t+rng->exponential(p->get_expand_interval());
+	// Thin the expansion rate to the directions that change something
+	int s = susceptible(cell,NULL);
+	if (s == 0)
+		return adevs_inf<double>();
+	int dirs = ModelRules::stencil_size(iType);
+	return t+rng->exponential(p->get_expand_interval()*dirs/s);
+}
+
+void TissueGrid::reset(int cell, double t)
+{
+	record(cell);
+	int iType = cells[cell];
+	double tm = adevs_inf<double>(), te = expand_time(cell,t);
+	// Anything might mutate
+	if (p->get_mutation_interval(iType) < adevs_inf<double>())
+		tm = t+rng->exponential(p->get_mutation_interval(iType));
+	// Cells that can never fire are not stored
+	if (tm == adevs_inf<double>() && te == adevs_inf<double>())
+		schedule.remove(cell);
+	// Otherwise the clocks are reset in place
+	else
+		schedule.set(cell,tm,te);
+}
@@ -0,0 +1,302 @@
+#ifndef _tissue_grid_h_
+#define _tissue_grid_h_
+#include "common.h"
+#include "EventQueue.h"
+#include "Census.h"
+#include "Rules.h"
+#include <vector>
+#include <iostream>
+
+/**
+ * Receives every change in the type of a cell of a TissueGrid.
+ */
+class CellObserver
+{
+	public:
+		/**
+		 * The cell with the given index changed from oldType to
+		 * newType at time t of the grid.
+		 */
+		virtual void changed(double t, int cell, int oldType, int newType) = 0;
+		virtual ~CellObserver(){}
+};
+
+/**
+ * A dense alternative to a CellSpace of TissueVolume models. The type
+ * of every cell is stored as a single byte in a flat array and event
+ * timers are kept only for cells that can mutate or expand. The
+ * transition rules are those of ModelRules, exactly as in the
+ * TissueVolume class.
+ */
+class TissueGrid
+{
+	public:
+		/**
+		 * An expansion from one grid into another when each is a part
+		 * of a larger space. The coordinates are those of the larger
+		 * space.
+		 */
+		struct Expansion
+		{
+			double t; // Time of the expansion
+			int x, y, z; // Cell that is invaded
+			int iType; // Type of the invading cell
+			bool operator<(const Expansion& other) const
+			{
+				if (t != other.t) return t < other.t;
+				if (y != other.y) return y < other.y;
+				if (x != other.x) return x < other.x;
+				if (z != other.z) return z < other.z;
+				return iType < other.iType;
+			}
+			bool operator==(const Expansion& other) const
+			{
+				return t == other.t && x == other.x && y == other.y &&
+					z == other.z && iType == other.iType;
+			}
+		};
+		/**
+		 * Create a grid of NORMAL cells with the given dimensions. Random
+		 * numbers are drawn from rng or, if rng is NULL, from the global
+		 * stream of the Parameters object. If the grid is only a part of
+		 * the space given by the Parameters object, then x0 and y0 are
+		 * the coordinates of its first cell in that space. Its cells
+		 * span the whole space in the z direction.
+		 */
+		TissueGrid(int nx, int ny, int nz, Random* rng = NULL, int x0 = 0, int y0 = 0);
+		/**
+		 * Simulate the BE cells as a single pool instead of giving each
+		 * one its own mutation clock. Every BE cell mutates at the same
+		 * rate, so the pool is a Poisson process whose rate is the sum
+		 * of the individual rates and the mutating cell is chosen
+		 * uniformly from the pool. Only the DYSPLASIA and CANCER cells
+		 * that result are simulated individually. This must be set
+		 * before any cells are added.
+		 */
+		void aggregate_be(bool flag) { pool_be = flag; }
+		/**
+		 * Schedule only expansions that will change the state of the
+		 * grid. A DYSPLASIA or CANCER cell with s of its n neighbors
+		 * open to invasion expands at s/n times the usual rate into one
+		 * of those s neighbors chosen uniformly. The rates are updated
+		 * whenever a neighbor changes type, so cells inside a clone
+		 * have no pending expansion. This must be set before any cells
+		 * are added and it requires a grid that covers the whole space.
+		 */
+		void frontier_only(bool flag) { frontier = flag; }
+		/**
+		 * Store only the rows (values of y) that hold cells other than
+		 * NORMAL plus a margin of NORMAL rows beyond them. NORMAL cells
+		 * that cannot mutate never change until cancer reaches them, so
+		 * the rows past the margin are added only when a DYSPLASIA or
+		 * CANCER cell comes within margin rows of the last one. Cells
+		 * that have not been stored are NORMAL. The results are the
+		 * same as for a grid that stores every row. This must be set
+		 * before any cells are added.
+		 */
+		void region_of_interest(int margin);
+		/**
+		 * Number of rows that are stored.
+		 */
+		int rows() const { return stored_rows; }
+		/**
+		 * Set the initial type of a cell. This has the same effect as
+		 * constructing a TissueVolume with that type at x, y, z.
+		 */
+		void add(int iType, int x, int y, int z);
+		/**
+		 * Get the type of the cell at x, y, z.
+		 */
+		int itype(int x, int y, int z) const
+		{
+			return (y < stored_rows) ? cells[index(x,y,z)] : NORMAL;
+		}
+		/**
+		 * Absolute time of the next event or infinity if there is none.
+		 */
+		double nextEventTime() const;
+		/**
+		 * Execute the next mutation or expansion event.
+		 */
+		void execNextEvent();
+		/**
+		 * Execute every event with a time less than or equal to tstop
+		 * and return the number of events that were executed.
+		 */
+		unsigned long execUntil(double tstop);
+		/**
+		 * Expansions out of this grid into the rest of the space since
+		 * clear_outgoing() was last called. Only a grid that is part of
+		 * a larger space will have these.
+		 */
+		const std::vector<Expansion>& outgoing() const { return outbox; }
+		void clear_outgoing() { outbox.clear(); }
+		/**
+		 * Set the expansions from the rest of the space into this grid.
+		 * These are applied in time order along with the grid's own
+		 * events. They replace any given by an earlier call.
+		 */
+		void incoming(const std::vector<Expansion>& xb);
+		/**
+		 * Record every event from now on so that the grid can be rolled
+		 * back to a time in the past. A grid that is part of a larger
+		 * space does this at the start of each window of the exchange.
+		 * The record holds the prior state of only the cells that
+		 * change, so it costs much less than a copy of the grid. This
+		 * cannot be used with region_of_interest.
+		 */
+		void mark();
+		/**
+		 * Undo every event at or after time t since mark() was called,
+		 * including the numbers drawn from rng and the expansions put
+		 * into the outbox, and replace the incoming expansions with
+		 * xb. The expansions in xb before t must be the ones that were
+		 * already applied. Returns the number of events undone.
+		 */
+		unsigned long rollback(double t, const std::vector<Expansion>& xb);
+		/**
+		 * Bytes recorded for each event after mark(). An event changes
+		 * the cell that fires and at most one neighbor.
+		 */
+		static size_t recorded_bytes_per_event() { return sizeof(Step)+2*sizeof(Undo); }
+		/**
+		 * Report every change of type from now on to obs, or to no one
+		 * if obs is NULL. A copy of the grid reports to the same
+		 * observer. This cannot be used with mark().
+		 */
+		void observe(CellObserver* obs) { observer = obs; }
+		/**
+		 * Use a different stream of random numbers.
+		 */
+		void random(Random* rng) { this->rng = rng; }
+		/**
+		 * Draw new clocks at time t for every cell that can fire and
+		 * for the BE pool. The clocks are exponential, so the future
+		 * of the grid has the same distribution as before, but it no
+		 * longer depends on the numbers that were drawn in the past.
+		 */
+		void redraw(double t);
+		/**
+		 * Write the cell types, clocks, and BE pool to a checkpoint.
+		 * The grid must cover the whole space and have no expansions
+		 * waiting to go in or out.
+		 */
+		void save(std::ostream& out) const;
+		/**
+		 * Read the state written by save() into a grid with the same
+		 * dimensions. Returns false if the checkpoint could not be
+		 * read or was made by a different grid.
+		 */
+		bool load(std::istream& in);
+		/**
+		 * Number of cells that have a pending event.
+		 */
+		unsigned active_cells() const { return schedule.size(); }
+		/**
+		 * Count of each cell type and the cells that are not NORMAL.
+		 * The indices are those of this grid. Add xorigin() and
+		 * yorigin() to get the position in the whole space.
+		 */
+		const Census& census() const { return pop; }
+		int xorigin() const { return x0; }
+		int yorigin() const { return y0; }
+		int xdim() const { return nx; }
+		int ydim() const { return ny; }
+		int zdim() const { return nz; }
+		~TissueGrid(){}
+	private:
+		const int nx, ny, nz; // Dimensions of the grid
+		const int x0, y0; // Position of the grid in the whole space
+		Parameters* p; // Model parameters
+		Random* rng; // Source of random numbers
+		std::vector<unsigned char> cells; // Cell types, one byte each
+		int stored_rows; // Rows of cells that are stored
+		int margin; // Rows to keep past the last cell that can invade or -1
+		Census pop; // Count of each type, kept up to date with cells
+		EventQueue schedule; // Clocks for the cells that can fire
+		bool frontier; // Are only state changing expansions scheduled?
+		bool pool_be; // Are BE cells simulated as a pool?
+		std::vector<int> pool; // Cells that were BE when the pool was last built
+		int pool_size; // Number of cells in the pool that are still BE or fewer
+		mutable double t_pool; // Time of the next pool mutation or < 0 if not drawn
+		std::vector<Expansion> outbox; // Expansions out of the grid
+		std::vector<Expansion> inbox; // Expansions into the grid in time order
+		unsigned next_in; // Next expansion in the inbox to apply
+		CellObserver* observer; // Told of every change of type or NULL
+		/// Prior type and clocks of a cell that changed after mark()
+		struct Undo
+		{
+			int cell;
+			unsigned char iType;
+			bool queued; // Was the cell in the schedule?
+			double tm, te; // Its clocks if it was
+		};
+		/// State of the grid before an event that followed mark()
+		struct Step
+		{
+			double t; // Time of the event
+			unsigned undone, sent, pools; // Sizes of undo, outbox and old_pools
+			int pool_size;
+			double t_pool;
+			Random rng;
+		};
+		bool recording; // Has mark() been called?
+		std::vector<Undo> undo; // Changes to the cells in the order they happened
+		std::vector<Step> steps; // Events in the order they happened
+		std::vector<std::vector<int> > old_pools; // BE pools replaced by a rebuild
+		/// Save the type and clocks of a cell that is about to change
+		void record(int cell)
+		{
+			if (!recording)
+				return;
+			Undo u;
+			const EventQueue::Entry* e = schedule.find(cell);
+			u.cell = cell;
+			u.iType = cells[cell];
+			u.queued = (e != NULL);
+			u.tm = (e == NULL) ? 0.0 : e->tm;
+			u.te = (e == NULL) ? 0.0 : e->te;
+			undo.push_back(u);
+		}
+		/// Time of the next expansion into the grid
+		double incoming_time() const
+		{
+			return (next_in < inbox.size()) ? inbox[next_in].t : adevs_inf<double>();
+		}
+		/// Time of the next mutation in the BE pool
+		double pool_time() const;
+		/// Mutate a randomly selected BE cell from the pool at time t
+		void pool_event(double t);
+		int index(int x, int y, int z) const { return (y*nz+z)*nx+x; }
+		/// Store the rows up to and including y plus the margin
+		void store_rows(int y);
+		/// Change the type of a cell at time t and update the census
+		void set_type(int cell, int iType, double t)
+		{
+			record(cell);
+			// Cells that can invade need their neighbors to be stored
+			if (margin >= 0 && ModelRules::can_expand(iType))
+				store_rows(cell/(nx*nz));
+			if (observer != NULL && cells[cell] != iType)
+				observer->changed(t,cell,cells[cell],iType);
+			pop.change(cell,cells[cell],iType);
+			cells[cell] = iType;
+		}
+		/// Draw new timers for a cell that has just taken on a type at time t
+		void reset(int cell, double t);
+		/// Reset a cell whose type changed at time t and update its neighbors
+		void changed(int cell, double t);
+		/// Apply an expansion of type iType into cell at time t
+		void invade(int cell, int iType, double t);
+		/// Time of the next expansion for a cell whose clock is reset at t
+		double expand_time(int cell, double t);
+		/**
+		 * Find the neighbors that a cell can invade and return how
+		 * many there are. Their indices are put into target if it is
+		 * not NULL. Neighbors reached by more than one direction are
+		 * counted once for each direction.
+		 */
+		int susceptible(int cell, int* target) const;
+};
+
+#endif
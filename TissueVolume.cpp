@@ -1,19 +1,37 @@
 #include "TissueVolume.h"
+#include "Telemetry.h"
+#include "Rules.h"
 
-TissueVolume::TissueVolume(int iType, int x, int y, int z):
+const Arena<TissueVolume>* TissueVolume::arena = NULL;
+
+TissueVolume::TissueVolume(int iType, int x, int y, int z, Random* rng,
+	Census* census, Random* init):
 	adevs::Atomic<adevs::CellEvent<int> >(),
 	iType(iType),
 	ttm(adevs_inf<double>()),
 	tte(adevs_inf<double>()),
-	x(x),y(y),z(z)
+	x(x),y(y),z(z),
+	rng((rng == NULL) ? Parameters::getInstance()->random() : rng),
+	census(NULL)
 {
 	Parameters* p = Parameters::getInstance();
-	// Only dysplasia and cancer can expand
-	if (iType == DYSPLASIA || iType == CANCER)
-		tte = p->exponential(p->get_expand_interval());
+	if (init == NULL)
+		init = this->rng;
+	attach(census);
+	if (ModelRules::can_expand(iType))
+		tte = init->exponential(p->get_expand_interval());
 	// Anything might mutate
 	if (p->get_mutation_interval(iType) < adevs_inf<double>())
-		ttm = p->exponential(p->get_mutation_interval(iType));
+		ttm = init->exponential(p->get_mutation_interval(iType));
+}
+
+void TissueVolume::attach(Census* census)
+{
+	assert(this->census == NULL);
+	this->census = census;
+	// The census starts with every cell NORMAL
+	if (census != NULL)
+		census->change(census->index(x,y,z),NORMAL,iType);
 }
 
 double TissueVolume::ta()
@@ -29,32 +47,31 @@ void TissueVolume::delta_int()
 	{
 		// Reduce our time to expand by what has passed
 		if (tte < adevs_inf<double>()) tte -= ttm;
-		// Cancer never mutates
-		assert(iType < CANCER);
+		// Only types that mutate into another have a mutation clock
+		assert(ModelRules::mutates_to(iType) != iType);
+		TELEMETRY_COUNT(MUTATE_EVENT,iType);
 		// Evolve our type
-		iType++;
+		set_type(ModelRules::mutates_to(iType));
 		// If we can mutate as the new type, pick a time to mutate
 		if (p->get_mutation_interval(iType) < adevs_inf<double>())
-			ttm = p->exponential(p->get_mutation_interval(iType));
+			ttm = rng->exponential(p->get_mutation_interval(iType));
 		// Otherwise never mutate
 		else ttm = adevs_inf<double>();
 		// If we can expand now then do so
-		if (iType >= DYSPLASIA)
-			tte = p->exponential(p->get_expand_interval());
+		if (ModelRules::can_expand(iType))
+			tte = rng->exponential(p->get_expand_interval());
 		// Otherwise never expand
 		else tte = adevs_inf<double>();
 	}
 	// If not mutating, then we are moving
 	else 
 	{
-		// Only dysplasia and cancer can spread
-		assert(iType == DYSPLASIA || iType == CANCER);
+		assert(ModelRules::can_expand(iType));
+		TELEMETRY_COUNT(EXPAND_EVENT,iType);
 		// Reduce our time to mutate
 		if (ttm < adevs_inf<double>()) ttm -= tte;
-		// Cancer can't mutate, but dysplasia can
-		assert(iType == CANCER || ttm < adevs_inf<double>());
 		// Set time to next expansion 
-		tte = p->exponential(p->get_expand_interval());
+		tte = rng->exponential(p->get_expand_interval());
 	}
 }
 
@@ -63,40 +80,35 @@ void TissueVolume::delta_ext(double e, const adevs::Bag<adevs::CellEvent<int> >&
 	// Reduce the time to next event
 	if (ttm < adevs_inf<double>()) ttm -= e;
 	if (tte < adevs_inf<double>()) tte -= e;
-	// Get the most aggressive type that is visiting us
+	// Get the most aggressive type that is visiting us and can invade
 	int newType = iType;
 	for (auto x : xb)
 	{
-		// Only dysplasia and cancer can spread
-		assert(x.value == DYSPLASIA || x.value == CANCER);
-		newType = (x.value > newType) ? x.value : newType;
+		assert(ModelRules::can_expand(x.value));
+		if (x.value > newType && ModelRules::can_invade(x.value,iType,z))
+			newType = x.value;
 	}
 	// If we are going to be invaded, reset the event timers
-	if
-	(
-		newType != iType && // No need to change in this case
-		(
-			newType == CANCER // Cancer always spreads
-				||
-			(iType == BE && newType == DYSPLASIA) // Dysplasia can spread into BE
-		)
-	)
+	if (newType != iType)
 	{
 		// Change our time
-		iType = newType;
+		set_type(newType);
 		Parameters* p = Parameters::getInstance();
 		// Set time to spread
-		tte = p->exponential(p->get_expand_interval());
+		tte = rng->exponential(p->get_expand_interval());
 		// Mutate if we can
 		if (p->get_mutation_interval(iType) < adevs_inf<double>())
-			ttm = p->exponential(p->get_mutation_interval(iType));
+			ttm = rng->exponential(p->get_mutation_interval(iType));
 		else
 			ttm = adevs_inf<double>();
 	}
+	else
+		TELEMETRY_COUNT(NO_OP_EVENT,iType);
 }
 
 void TissueVolume::delta_conf(const adevs::Bag<adevs::CellEvent<int> >& xb)
 {
+	TELEMETRY_COUNT(CONFLUENT_EVENT,iType);
 	delta_int();
 	delta_ext(0.0,xb);
 }
@@ -107,20 +119,17 @@ void TissueVolume::output_func(adevs::Bag<adevs::CellEvent<int> >& yb)
 	// to one of our neighbors.
 	if (tte < ttm)
 	{
-		// Only cancer and dysplasia can spread
-		assert(iType == CANCER || iType == DYSPLASIA);
-		int dx = 0, dy = 0, dz = 0;
+		assert(ModelRules::can_expand(iType));
 		adevs::CellEvent<int> out;
-		// Cancer can spread anywhere
-		if (iType == CANCER)
-			Parameters::getInstance()->direction(dx,dy,dz);
-		// Dysplasia is stuck on the surface
-		else
-			Parameters::getInstance()->direction(dx,dy);
-		dx += x; dy += y; dz += z;
+		// Each type spreads in the directions of its own stencil
+		const int* d = ModelRules::offset(rng->direction(ModelRules::stencil_size(iType)));
+		int dx = x+d[0], dy = y+d[1], dz = z+d[2];
 		// If direction is out of the space, then no output
 		if (!Parameters::getInstance()->wrap(dx,dy,dz))
+		{
+			TELEMETRY_COUNT(OFF_GRID_EVENT,iType);
 			return;
+		}
 		out.x = dx; out.y = dy; out.z = dz;
 		out.value = iType;
 		yb.insert(out);
@@ -1,6 +1,15 @@
 #ifndef _cell_h_
 #define _cell_h_
 #include "common.h"
+#include "Census.h"
+#include "Arena.h"
+
+/**
+ * When many volumes are created at once, volume n draws its first event
+ * times from this stream number plus n of the seed. The stream number
+ * is past 32 bits so it cannot meet the other streams of the seed.
+ */
+#define VOXEL_STREAM 0x100000000UL
 
 /**
  * Model of a volume of tissue.
@@ -9,7 +18,31 @@ class TissueVolume:
 	public adevs::Atomic<adevs::CellEvent<int> >
 {
 	public:
-		TissueVolume(int iType, int x, int y, int z);
+		/**
+		 * Create a volume of the given type at x, y, z. Random numbers are
+		 * drawn from rng or, if rng is NULL, from the global stream of the
+		 * Parameters object. If init is not NULL, then the first event
+		 * times are drawn from it instead, which lets many volumes be
+		 * created at once. If census is not NULL then every change of
+		 * type is reported to it.
+		 */
+		TissueVolume(int iType, int x, int y, int z, Random* rng = NULL,
+			Census* census = NULL, Random* init = NULL);
+		/**
+		 * Report every change of type to census from now on, starting
+		 * with our current type. The census must not be set already.
+		 */
+		void attach(Census* census);
+		/**
+		 * Volumes constructed in this arena are not freed one at a time
+		 * when they are deleted. The arena frees them all at once.
+		 */
+		static void use_arena(const Arena<TissueVolume>* a) { arena = a; }
+		static void operator delete(void* p)
+		{
+			if (arena == NULL || !arena->owns(p))
+				::operator delete(p);
+		}
 		double ta();
 		void delta_int();
 		void delta_ext(double e, const adevs::Bag<adevs::CellEvent<int> >& xb);
@@ -25,6 +58,16 @@ class TissueVolume:
 		int iType; // Type of cell in the volume
 		double ttm, tte; // Time to mutate and expand
 		const int x, y, z; // Location in the grid space
+		Random* rng; // Source of random numbers
+		Census* census; // Count of each type in the grid or NULL
+		static const Arena<TissueVolume>* arena; // Shared storage or NULL
+		/// Change our type and report it to the census
+		void set_type(int newType)
+		{
+			if (census != NULL)
+				census->change(census->index(x,y,z),iType,newType);
+			iType = newType;
+		}
 };
 
 #endif
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Throughput of the simulation core for fixed scenarios at two grid sizes.
+# Usage: ./bench.sh [other a.out arguments]
+# Prints one CSV row per run to stdout. The seeds are chosen so that the
+# clone scenario has a single dysplasia clone and the cancer scenario
+# stops while the cancer is still spreading.
+#  quiescent - A BE segment that does not change
+#  clone     - One dysplasia clone growing through the BE segment
+#  cancer    - Cancer spreading through a 2 cm section at a high diffusion_rate
+version=`git describe --always --dirty 2>/dev/null || echo unknown`
+echo "version,scenario,grid_size,seed,engine,init_seconds,events,seconds,events_per_sec,ns_per_event,peak_rss_kb,snapshot_seconds"
+while read scenario grid seed ages
+do
+	./a.out -bench -var bench/$scenario.txt -set grid_size $grid -ranseed $seed "$@" $ages > bench.out
+	value() { grep "^$1 :" bench.out | cut -d: -f2 | tr -d ' '; }
+	echo "$version,$scenario,$grid,$seed,`value engine`,`value "init seconds"`,`value events`,`value seconds`,`value events/sec`,`value ns/event`,`value "peak rss kB"`,`value "snapshot seconds"`"
+done <<SCENARIOS
+quiescent 0.42 1 40 60
+quiescent 0.21 1 40 60
+clone 0.42 4 40 50
+clone 0.21 10 40 50
+cancer 0.42 3 10 12
+cancer 0.21 1 8 9
+SCENARIOS
+rm -f bench.out
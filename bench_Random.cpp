@@ -0,0 +1,48 @@
+#include "Random.h"
+#include <chrono>
+#include <iostream>
+using namespace std;
+
+/**
+ * Time the draws of the hot path with and without pools. Prints the ns
+ * per draw of each as CSV.
+ */
+static double time_exponential(bool pooled, int count, double& sum)
+{
+	Random r(1,1);
+	r.pool(pooled);
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < count; i++)
+		sum += r.exponential(2.0);
+	return 1E9*chrono::duration<double>(chrono::steady_clock::now()-start).count()/count;
+}
+
+static double time_direction(bool pooled, int count, double& sum)
+{
+	Random r(1,1);
+	r.pool(pooled);
+	int dx, dy, dz;
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		r.direction(dx,dy,dz);
+		sum += dx+2*dy+3*dz;
+	}
+	return 1E9*chrono::duration<double>(chrono::steady_clock::now()-start).count()/count;
+}
+
+int main()
+{
+	const int count = 50000000;
+	double sum = 0.0;
+	cout << "draw,plain_ns,pooled_ns,speedup" << endl;
+	double plain = time_exponential(false,count,sum);
+	double pooled = time_exponential(true,count,sum);
+	cout << "exponential," << plain << "," << pooled << "," << plain/pooled << endl;
+	plain = time_direction(false,count,sum);
+	pooled = time_direction(true,count,sum);
+	cout << "direction," << plain << "," << pooled << "," << plain/pooled << endl;
+	// Keep the draws from being optimized away
+	cerr << "sum : " << sum << endl;
+	return 0;
+}
@@ -1,61 +1,56 @@
 #include "common.h"
+#include "Rules.h"
 #include <fstream>
 #include <string>
 #include <sstream>
 
 Parameters* Parameters::inst = NULL; // The singleton instance
+thread_local Parameters* Parameters::local = NULL;
 
 double Parameters::uniform()
 {
-	return gsl_rng_uniform(r);
+	return rng.uniform();
+}
+
+unsigned long Parameters::uniform_int(unsigned long n)
+{
+	return rng.uniform_int(n);
 }
 
 double Parameters::exponential(double mu)
 {
-	return gsl_ran_exponential(r,mu);
+	return rng.exponential(mu);
 }
 
 double Parameters::normal(double mean, double std_dev)
 {
-	return gsl_ran_gaussian(r,sqrt(std_dev))+mean;
+	return rng.normal(mean,std_dev);
 }
 
 void Parameters::direction(int& dx, int& dy, int& dz)
 {
-	int dir = gsl_rng_uniform_int (r,6);
-	dx = dy = dz = 0;
-	if (dir == 0) dx = 1;
-	else if (dir == 1) dx = -1;
-	else if (dir == 2) dy = 1;
-	else if (dir == 3) dy = -1;
-	else if (dir == 4) dz = 1;
-	else dz = -1;
+	rng.direction(dx,dy,dz);
 }
 
 void Parameters::direction(int& dx, int& dy)
 {
-	int dir = gsl_rng_uniform_int (r,4);
-	dx = dy = 0;
-	if (dir == 0) dx = 1;
-	else if (dir == 1) dx = -1;
-	else if (dir == 2) dy = 1;
-	else dy = -1;
+	rng.direction(dx,dy);
 }
 
 bool Parameters::wrap(int& x, int& y, int& z) const
 {
-	if (x < 0) x = nx-1;
-	else if (x >= nx) x = 0;
-	return (y >= 0 && y < ny && z >= 0 && z < nz);
+	return ModelRules::wrap(x,y,z,nx,ny,nz);
 }
 
 void Parameters::set_seed(unsigned long seed)
 {
-	gsl_rng_set(r,seed);
+	rng.set_seed(seed);
 }
 
 Parameters* Parameters::getInstance()
 {
+	if (local != NULL)
+		return local;
 	if (inst == NULL)
 		inst = new Parameters();
 	return inst;
@@ -67,17 +62,34 @@ void Parameters::deleteInstance()
 	inst = NULL;
 }
 
+Parameters::Scope::Scope(Parameters* p):
+	prev(local)
+{
+	local = p;
+}
+
+Parameters::Scope::~Scope()
+{
+	local = prev;
+}
+
 Parameters::Parameters():
 	nx(-1),
 	ny(-1),
 	nz(-1),
-	dx(-1.0),
+	dx(0.42),
 	diff_time(adevs_inf<double>()),
 	stem_cells_per_mm2(-1.0),
-	be_onset(-1.0)
+	be_onset(-1.0),
+	circ(75.4),
+	len(250.0),
+	thick(4.0),
+	pooled(false)
 {
-	r = gsl_rng_alloc(gsl_rng_mt19937);
-	gsl_rng_set(r,0);
+	// Fractions of the wall thickness
+	const double fractions[NUM_LAYERS] = { 0.2, 0.1, 0.2, 0.1, 0.4 };
+	for (int i = 0; i < NUM_LAYERS; i++)
+		layers[i] = fractions[i];
 	for (int i = 0; i < NUM_CELL_TYPES; i++)
 	{
 		mutate_time[i] = adevs_inf<double>();
@@ -86,14 +98,114 @@ Parameters::Parameters():
 
 Parameters::~Parameters()
 {
-	gsl_rng_free(r);
+}
+
+// Names of the layer fractions in the input file
+static const char* layer_names[NUM_LAYERS] =
+{
+	"layer_epithelium",
+	"layer_basement_membrane",
+	"layer_lamina_propia",
+	"layer_muscularis_mucosa",
+	"layer_submucosa"
+};
+
+// Names of the other parameters in the input file
+static const char* param_names[] =
+{
+	"diffusion_rate",
+	"mutate_normal",
+	"mutate_be",
+	"mutate_dysplasia",
+	"stem_cell_density",
+	"be_onset_age",
+	"grid_size",
+	"circumference",
+	"length",
+	"thickness",
+	NULL
+};
+
+void Parameters::size_grid()
+{
+	nx = (circ/dx)+1;
+	ny = (len/dx)+1;
+	nz = (thick/dx)+1;
+}
+
+bool Parameters::set(const std::string& param, double value)
+{
+	bool known = false;
+	for (int i = 0; param_names[i] != NULL; i++)
+		known = known || (param == param_names[i]);
+	for (int i = 0; i < NUM_LAYERS; i++)
+		known = known || (param == layer_names[i]);
+	if (known)
+		given[param] = value;
+	return known;
+}
+
+void Parameters::apply()
+{
+	std::string error;
+	if (!apply(error))
+	{
+		cout << error << endl;
+		exit(0);
+	}
+}
+
+bool Parameters::apply(std::string& error)
+{
+	std::map<std::string,double>::const_iterator iter;
+	// The geometry comes first because the rates depend on the cell size
+	if ((iter = given.find("grid_size")) != given.end())
+		cell_size(iter->second);
+	if ((iter = given.find("circumference")) != given.end())
+		circumference(iter->second);
+	if ((iter = given.find("length")) != given.end())
+		length(iter->second);
+	if ((iter = given.find("thickness")) != given.end())
+		thickness(iter->second);
+	for (int i = 0; i < NUM_LAYERS; i++)
+		if ((iter = given.find(layer_names[i])) != given.end())
+			layer_fraction(i,iter->second);
+	if ((iter = given.find("stem_cell_density")) != given.end())
+		set_stem_cells_per_mm2(iter->second);
+	if ((iter = given.find("be_onset_age")) != given.end())
+		be_onset_age(iter->second);
+	if (dx <= 0.0 || circ <= 0.0 || len <= 0.0 || thick <= 0.0)
+	{
+		error = "The grid_size, circumference, length and thickness must be positive.";
+		return false;
+	}
+	if (be_onset < 0.0)
+	{
+		error = "The be_onset_age must be positive.";
+		return false;
+	}
+	if (stem_cells_per_mm2 < 0.0)
+	{
+		error = "The stem_cell_density must be positive.";
+		return false;
+	}
+	if ((iter = given.find("diffusion_rate")) != given.end())
+		set_diffusion_rate(iter->second);
+	if ((iter = given.find("mutate_normal")) != given.end() && iter->second > 0.0)
+		set_mutations_per_year(iter->second,NORMAL);
+	if ((iter = given.find("mutate_be")) != given.end() && iter->second > 0.0)
+		set_mutations_per_year(iter->second,BE);
+	if ((iter = given.find("mutate_dysplasia")) != given.end() && iter->second > 0.0)
+		set_mutations_per_year(iter->second,DYSPLASIA);
+	for (auto& v : given)
+		settings[v.first] = v.second;
+	given.clear();
+	size_grid();
+	return true;
 }
 
 void Parameters::load_from_file(const char* filename)
 {
-	double mutate_normal = -1.0,
-		mutate_be = -1.0,
-		mutate_dysplasia = -1.0;
 	ifstream fin(filename);
 	if (fin.bad())
 	{
@@ -105,39 +217,11 @@ void Parameters::load_from_file(const char* filename)
 		istringstream sin(line);
 		string param; double value;
 		sin >> param >> value;
-		if (param == "diffusion_rate")
-			set_diffusion_rate(value);	
-		else if (param == "mutate_normal")
-			mutate_normal = value;
-		else if (param == "mutate_be")
-			mutate_be = value;
-		else if (param == "mutate_dysplasia")
-			mutate_dysplasia = value;
-		else if (param == "stem_cell_density")
-			set_stem_cells_per_mm2(value);
-		else if (param == "be_onset_age")
-			be_onset_age(value);
-		else
+		if (!set(param,value))
 		{
 			cout << "Unknown parameter " << param << endl;
 			exit(0);
 		}
 	}
-	if (be_onset < 0.0)
-	{
-		cout << "The be_onset_age must be positive." << endl;
-		exit(0);
-	}
-	if (stem_cells_per_mm2 < 0.0)
-	{
-		cout << "The stem_cell_density must be positive." << endl;
-		exit(0);
-	}
-	if (mutate_normal > 0.0)
-		set_mutations_per_year(mutate_normal,NORMAL);
-	if (mutate_be > 0.0)
-		set_mutations_per_year(mutate_be,BE);
-	if (mutate_dysplasia > 0.0)
-		set_mutations_per_year(mutate_dysplasia,DYSPLASIA);
 	fin.close();
 }
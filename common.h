@@ -1,7 +1,9 @@
 #ifndef _common_h_
 #define _common_h_
 #include "adevs.h"
-#include <gsl/gsl_randist.h>
+#include "Random.h"
+#include <string>
+#include <map>
 
 /**
  * Types of cells in the model. These
@@ -14,15 +16,51 @@
 #define NUM_CELL_TYPES 4
 
 /**
- * This class stores all globally visible model parameters.
+ * Layers of the esophageal wall from the surface down.
+ */
+#define EPITHELIUM 0
+#define BASEMENT_MEMBRANE 1
+#define LAMINA_PROPIA 2
+#define MUSCULARIS_MUCOSA 3
+#define SUBMUCOSA 4
+#define NUM_LAYERS 5
+
+/**
+ * This class stores all globally visible model parameters. The
+ * instance returned by getInstance() is a singleton unless the calling
+ * thread has entered a Scope, which lets each thread of a program that
+ * embeds the model work with its own parameters.
  */
 class Parameters
 {
 	public:
+		/**
+		 * Create a set of parameters with the default values. Use a
+		 * Scope to make the engines see it.
+		 */
+		Parameters();
+		~Parameters();
+		/**
+		 * Make a Parameters object the instance that getInstance()
+		 * returns to the calling thread until the scope ends. Scopes
+		 * can be nested.
+		 */
+		class Scope
+		{
+			public:
+				Scope(Parameters* p);
+				~Scope();
+			private:
+				Parameters* prev;
+		};
 		/**
 		 * Set the random number seed.
 		 */
 		void set_seed(unsigned long seed);
+		/**
+		 * Get the global random number stream.
+		 */
+		Random* random() { return &rng; }
 		/**
 		 * Use the global random number generator to
 		 * sample an exponential distribution with mean mu.
@@ -32,6 +70,10 @@ class Parameters
 		 * Return a number in [0,1]
 		 */
 		double uniform();
+		/**
+		 * Return an integer in [0,n)
+		 */
+		unsigned long uniform_int(unsigned long n);
 		/** Sample a normal distribution */
 		double normal(double mean, double std_dev);
 		/**
@@ -87,7 +129,8 @@ class Parameters
 		 */
 		bool wrap(int& x, int& y, int& z) const;
 		/**
-		 * Get the singleton instance of this object.
+		 * Get the instance of the calling thread's Scope or, if it has
+		 * not entered one, the singleton instance.
 		 */
 		static Parameters* getInstance();
 		/**
@@ -96,6 +139,11 @@ class Parameters
 		void set_stem_cells_per_mm2(double count) {
 			stem_cells_per_mm2 = count;
 		}
+		/**
+		 * Get stem cells per square mm or a negative number if it has
+		 * not been set.
+		 */
+		double get_stem_cells_per_mm2() const { return stem_cells_per_mm2; }
 		/**
 		 * Set the mean age for onset of BE
 		 */
@@ -109,25 +157,81 @@ class Parameters
 			return be_onset;
 		}
 		/**
-		 * Load parameter data from a text file.
+		 * Should the streams used by the engines draw exponentials and
+		 * directions from pools? See Random::pool().
+		 */
+		bool pooled_random() const { return pooled; }
+		void pooled_random(bool flag) { pooled = flag; rng.pool(flag); }
+		/**
+		 * Get or set the size of the esophagus in mm. The grid
+		 * dimensions are found from these and the cell size by
+		 * size_grid().
+		 */
+		double circumference() const { return circ; }
+		double length() const { return len; }
+		double thickness() const { return thick; }
+		void circumference(double mm) { circ = mm; }
+		void length(double mm) { len = mm; }
+		void thickness(double mm) { thick = mm; }
+		/**
+		 * Get or set the fraction of the wall thickness taken up by
+		 * a layer.
+		 */
+		double layer_fraction(int layer) const { return layers[layer]; }
+		void layer_fraction(int layer, double fraction) { layers[layer] = fraction; }
+		/**
+		 * Set the number of cells in the x, y, and z directions from
+		 * the circumference, length, thickness, and cell size.
+		 */
+		void size_grid();
+		/**
+		 * Set a parameter by the name that it has in the input file.
+		 * The value is not applied until apply() is called. Returns
+		 * false if the name is not recognized.
+		 */
+		bool set(const std::string& param, double value);
+		/**
+		 * Apply the values given to set(). This sets the cell size,
+		 * the geometry, and then the rates, which depend on the cell
+		 * size. The grid is sized by size_grid(). Exits if a required
+		 * value is missing.
+		 */
+		void apply();
+		/**
+		 * The same, but returns false and puts the reason into error
+		 * instead of exiting.
+		 */
+		bool apply(std::string& error);
+		/**
+		 * Every value that has been applied by name, with the last
+		 * value given for each. Giving these to set() for a new
+		 * Parameters object makes a copy of this one.
+		 */
+		const std::map<std::string,double>& applied() const { return settings; }
+		/**
+		 * Load parameter data from a text file. The values are applied
+		 * by apply().
 		 */
 		void load_from_file(const char* filename);
 		/// Delete the current singleton instance
 		static void deleteInstance();
 	private:
-		/// This is a singleton, so constructor and destructor are private
-		Parameters();
 		Parameters(const Parameters&){}
 		Parameters& operator=(const Parameters& other) { return *this; } 
-		~Parameters();
-		gsl_rng *r; // RNG and Distribution package
+		Random rng; // The global random number stream
 		int nx, ny, nz; // Number of cells in each direction
 		double dx; // Size of a cell
 		double diff_time; // Mean time to a diffusion event
 		double mutate_time[NUM_CELL_TYPES];
 		double stem_cells_per_mm2;
 		double be_onset;
+		double circ, len, thick; // Size of the esophagus in mm
+		double layers[NUM_LAYERS]; // Fraction of the wall in each layer
+		std::map<std::string,double> given; // Values waiting for apply()
+		std::map<std::string,double> settings; // Values that have been applied
+		bool pooled; // Use pooled random numbers?
 		static Parameters* inst; // The singleton instance
+		static thread_local Parameters* local; // Instance of the thread's Scope
 };
 
 #endif
@@ -0,0 +1,123 @@
+#include "esoabm.h"
+#include "Patient.h"
+#include <cstring>
+#include <vector>
+
+struct esoabm_model
+{
+	Parameters params; // Seen by the engines through a Scope
+	Patient* patient;
+	Random biopsy_rng; // Places the biopsies
+	double age; // Last age that was simulated
+};
+
+/**
+ * Copy a message into a buffer of the caller.
+ */
+static void copy_error(const std::string& msg, char* error, int error_size)
+{
+	if (error == NULL || error_size < 1)
+		return;
+	strncpy(error,msg.c_str(),error_size-1);
+	error[error_size-1] = 0;
+}
+
+void esoabm_defaults(esoabm_params* params)
+{
+	const Parameters p;
+	// A new Parameters object has no diffusion or mutations
+	params->diffusion_rate = 0.0;
+	params->be_onset_age = p.be_onset_age();
+	params->mutate_normal = params->mutate_be = params->mutate_dysplasia = 0.0;
+	params->stem_cell_density = p.get_stem_cells_per_mm2();
+	params->grid_size = p.cell_size();
+	params->circumference = p.circumference();
+	params->length = p.length();
+	params->thickness = p.thickness();
+	for (int i = 0; i < NUM_LAYERS; i++)
+		params->layers[i] = p.layer_fraction(i);
+	params->aggregate = params->frontier = params->hybrid = params->pooled = 0;
+}
+
+esoabm_model* esoabm_create(const esoabm_params* params, unsigned long seed,
+	char* error, int error_size)
+{
+	static const char* layer_names[NUM_LAYERS] = {
+		"layer_epithelium", "layer_basement_membrane", "layer_lamina_propia",
+		"layer_muscularis_mucosa", "layer_submucosa" };
+	esoabm_model* model = new esoabm_model();
+	Parameters& p = model->params;
+	p.set("diffusion_rate",params->diffusion_rate);
+	p.set("be_onset_age",params->be_onset_age);
+	p.set("mutate_normal",params->mutate_normal);
+	p.set("mutate_be",params->mutate_be);
+	p.set("mutate_dysplasia",params->mutate_dysplasia);
+	p.set("stem_cell_density",params->stem_cell_density);
+	p.set("grid_size",params->grid_size);
+	p.set("circumference",params->circumference);
+	p.set("length",params->length);
+	p.set("thickness",params->thickness);
+	for (int i = 0; i < NUM_LAYERS; i++)
+		p.set(layer_names[i],params->layers[i]);
+	p.pooled_random(params->pooled != 0);
+	std::string msg;
+	if (params->diffusion_rate < 0.0 || params->mutate_normal < 0.0 ||
+		params->mutate_be < 0.0 || params->mutate_dysplasia < 0.0)
+		msg = "The diffusion_rate and mutation rates cannot be negative.";
+	if (!msg.empty() || !p.apply(msg))
+	{
+		copy_error(msg,error,error_size);
+		delete model;
+		return NULL;
+	}
+	Parameters::Scope scope(&p);
+	model->patient = new Patient(seed,params->aggregate != 0,params->frontier != 0,
+		params->hybrid != 0);
+	model->biopsy_rng.set_seed(seed,BIOPSY_STREAM);
+	model->age = 0.0;
+	return model;
+}
+
+int esoabm_run(esoabm_model* model, const double* ages, int n, int* counts,
+	const esoabm_protocol* protocol, double* detected)
+{
+	for (int a = 0; a < n; a++)
+		if (ages[a] < ((a == 0) ? model->age : ages[a-1]))
+			return -1;
+	Parameters::Scope scope(&(model->params));
+	Protocol* surveillance = NULL;
+	if (protocol != NULL)
+	{
+		if ((protocol->kind != ESOABM_SEATTLE && protocol->kind != ESOABM_RANDOM) ||
+			protocol->endoscopies < 1 || detected == NULL ||
+			(surveillance = Protocol::jumbo((protocol->kind == ESOABM_SEATTLE) ?
+				Protocol::SEATTLE : Protocol::RANDOM,protocol->param,&(model->params))) == NULL)
+			return -1;
+	}
+	std::vector<double> when(ages,ages+n);
+	follow_patient(*(model->patient),when,&(model->biopsy_rng),surveillance,
+		(protocol != NULL) ? protocol->endoscopies : 0,counts,detected);
+	delete surveillance;
+	if (n > 0)
+		model->age = ages[n-1];
+	return 0;
+}
+
+double esoabm_be_length(const esoabm_model* model)
+{
+	return model->patient->be_length()*model->params.cell_size()/10.0;
+}
+
+double esoabm_be_onset(const esoabm_model* model)
+{
+	return model->patient->be_onset();
+}
+
+void esoabm_destroy(esoabm_model* model)
+{
+	if (model == NULL)
+		return;
+	Parameters::Scope scope(&(model->params));
+	delete model->patient;
+	delete model;
+}
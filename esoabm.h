@@ -0,0 +1,117 @@
+#ifndef _esoabm_h_
+#define _esoabm_h_
+
+/**
+ * A C interface for embedding the model of one patient in another
+ * program, e.g. the inner loop of a calibration. Each model owns its
+ * parameters, random numbers and tissue, and the library has no global
+ * state, so models can be created and run by many threads at once as
+ * long as each model is used by one thread at a time. Nothing is read
+ * from or written to files and results go into buffers owned by the
+ * caller. Link with libesoabm.a, which is built by make lib.
+ *
+ * A model is a Patient of the grid engine. Its seed gives it the same
+ * BE segment, onset age and history as patient seed of a -cohort run
+ * with the same parameters and options.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The number of cell types. Counts are in the order normal, BE,
+ * dysplasia and cancer.
+ */
+#define ESOABM_TYPES 4
+
+/**
+ * Kinds of surveillance. See Protocol.
+ */
+#define ESOABM_SEATTLE 0
+#define ESOABM_RANDOM 1
+
+/**
+ * Parameters of the model. The names and units are those of the input
+ * file. A rate of zero means that the mutation never happens. The
+ * options are the command line flags of the same name and are off if
+ * zero.
+ */
+typedef struct
+{
+	double diffusion_rate;
+	double be_onset_age;
+	double mutate_normal;
+	double mutate_be;
+	double mutate_dysplasia;
+	double stem_cell_density;
+	double grid_size;
+	double circumference;
+	double length;
+	double thickness;
+	double layers[5]; /* Fractions of the wall from the surface down */
+	int aggregate;
+	int frontier;
+	int hybrid;
+	int pooled;
+} esoabm_params;
+
+/**
+ * Endoscopies to perform at each age. For ESOABM_SEATTLE, param is the
+ * spacing of the levels in cm. For ESOABM_RANDOM, it is the number of
+ * biopsies.
+ */
+typedef struct
+{
+	int kind;
+	double param;
+	int endoscopies;
+} esoabm_protocol;
+
+typedef struct esoabm_model esoabm_model;
+
+/**
+ * Fill params with the defaults of the model. These are the geometry
+ * and no diffusion or mutations. The be_onset_age and stem_cell_density
+ * have no default and are negative, so they must be set, as in an input
+ * file.
+ */
+void esoabm_defaults(esoabm_params* params);
+
+/**
+ * Create the model of a patient. Returns NULL if the parameters are not
+ * valid, and then copies the reason into error if error is not NULL.
+ * At most error_size characters, including the terminating 0, are
+ * copied.
+ */
+esoabm_model* esoabm_create(const esoabm_params* params, unsigned long seed,
+	char* error, int error_size);
+
+/**
+ * Simulate the patient to each of n ages, which must increase and not
+ * be less than the last age of an earlier call. The count of each type
+ * at age a is put into counts[a*ESOABM_TYPES+type]. If protocol is not
+ * NULL, then the fraction of its endoscopies that found each type or a
+ * more advanced one is put into detected in the same way. The biopsies
+ * come from a stream of their own, so they do not change the tissue.
+ * Returns 0, or -1 if the ages or protocol are not valid.
+ */
+int esoabm_run(esoabm_model* model, const double* ages, int n, int* counts,
+	const esoabm_protocol* protocol, double* detected);
+
+/**
+ * Length in cm of the BE segment and the age at which BE appears.
+ */
+double esoabm_be_length(const esoabm_model* model);
+double esoabm_be_onset(const esoabm_model* model);
+
+/**
+ * Free a model.
+ */
+void esoabm_destroy(esoabm_model* model);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
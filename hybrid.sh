@@ -0,0 +1,29 @@
+#!/bin/sh
+# Compare a cohort that simulates every cell from the onset of BE with
+# the same cohort run with -hybrid.
+# Usage: ./hybrid.sh PATIENTS [other a.out arguments] AGES
+# Prints the seconds for each run and then, at each age, the fraction of
+# patients with a clone (dysplasia or cancer) and with cancer in each run
+# and the z score of the difference. The cohorts use different random
+# numbers, so |z| should mostly be below 2.
+patients=$1
+shift
+incidence() {
+	awk -F, 'NR > 1 { n[$4]++; if ($7+$8 > 0) d[$4]++; if ($8 > 0) c[$4]++ }
+		END { for (a in n) print a, n[a], d[a]+0, c[a]+0 }' cohort.csv | sort
+}
+now() { date +%s.%N; }
+start=`now`
+./a.out -cohort $patients "$@" > /dev/null
+full=`now`
+incidence > hybrid.full
+./a.out -cohort $patients -hybrid "$@" > /dev/null
+end=`now`
+incidence > hybrid.fast
+awk -v s=$start -v f=$full -v e=$end 'BEGIN {
+	printf "full seconds : %g\nhybrid seconds : %g\nspeedup : %g\n", f-s, e-f, (f-s)/(e-f) }'
+echo "age,clone_full,clone_hybrid,clone_z,cancer_full,cancer_hybrid,cancer_z"
+join hybrid.full hybrid.fast | sort -n | awk '
+	function z(x, y, n,  p) { p = (x+y)/(2*n); return (p > 0 && p < 1) ? (x-y)/sqrt(2*n*p*(1-p)) : 0 }
+	{ printf "%s,%g,%g,%.2f,%g,%g,%.2f\n", $1, $3/$2, $6/$5, z($3,$6,$2), $4/$2, $7/$5, z($4,$7,$2) }'
+rm -f hybrid.full hybrid.fast
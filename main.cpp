@@ -3,8 +3,23 @@
 #include <string>
 #include <cstring>
 #include <list>
+#include <vector>
+#include <chrono>
+#include <cmath>
 #include "common.h"
 #include "TissueVolume.h"
+#include "Patient.h"
+#include "Cohort.h"
+#include "Splitting.h"
+#include "Sweep.h"
+#include "ParallelTissue.h"
+#include "Snapshot.h"
+#include "EventLog.h"
+#include "Biopsy.h"
+#include "Checkpoint.h"
+#include "Memory.h"
+#include "Telemetry.h"
+#include <omp.h>
 using namespace std;
 using namespace adevs;
 
@@ -14,8 +29,10 @@ The diameter of your esophagus is 24mm, the diameter of a quarter.
 The thickness of your esophageal wall is 4mm, the width of 3 pennies.
 
 We will use 24 mm in our simulation which gives the circumference to be 75.4 mm.  
-The grid width is 0.42 mm for ni = 179 or 0.21 mm for ni = 359.
-Jumbo biopsy is about 5mmx3mm (12 by 7 grid) or (24 by 14 grid).
+The grid width is 0.42 mm for ni = 180 or 0.21 mm for ni = 360. The size
+of the esophagus and the grid width are set in the input file or with -set.
+Jumbo biopsy is about 5mmx3mm (12 by 7 grid) or (24 by 14 grid). See
+Protocol::jumbo.
 
 This model is based closely on the one appearing in
 
@@ -38,29 +55,50 @@ volumes will spread into NORMAL and DYSPLASIA volumes.
 The tumor grows via these two processes of mutation and growth. All of the
 growth and mutation rules can be found in the TumorVolume class.
 
+The same rules are implemented by the TissueGrid class, which stores the
+cell types in a packed array and keeps event timers only for cells that
+can change. Select it with the -engine grid command line option. Each
+Patient has its own TissueGrid and random number stream, which lets the
+-cohort option simulate many patients at once. The -sectors and -slabs
+options split the grid of a single patient into parts that are
+simulated in parallel by the ParallelTissue class. With -hybrid, the
+patients of a cohort draw the birth of their first DYSPLASIA clone from
+the first stage of the multistage clonal expansion model and build their
+grid only then. The -split option estimates the probability of cancer by
+each biopsy age with multilevel splitting. See Splitting.h. The -sweep
+option simulates a cohort for every row of a design matrix and
+summarizes the outcomes of each row as it goes. See Sweep.h. The
+-endpoint option ends a run, or each patient of a cohort, as soon as its
+outcome is decided and reports when that was.
+
+The -protocol option emulates surveillance by endoscopy. A BiopsyIndex
+summarizes the surface of the tissue at each biopsy age and jumbo
+biopsies are sampled from it by a Seattle or random Protocol.
+
+With the grid engine, -log records every change of type to a binary
+log from which the replay program rebuilds the grid at any age. See
+EventLog.h. The state of the simulation can also be saved to a
+checkpoint with -checkpoint and restored with -restore. The -forks
+option simulates many futures of one patient from a checkpoint.
+
+The -estimate option prints the memory that a run will need and the
+-memory option sets a budget for it. See Memory.h.
+
 ********************************************************************************/
 
-#define NUM_LAYERS 5
-// Fractional thickness of each layer
-static const double LayerThicknessFraction[NUM_LAYERS] =
-{
-	0.2, // Epithelium
-	0.1, // Basement membrane
-	0.2, // Lamina propia
-	0.1, // Mucular mucosaa
-	0.4  // Submucosa
-};
-
-static const double grid_size = 0.42; // mm
-static const double thickness = 4.0; // mm
-static const double circumference = 75.4; // mm
-static const double length = 250.0; // mm
-static const int ni = (circumference / grid_size)+1; // Spatial points in X direction. 
-static const int nj = (length / grid_size)+1; // Spatial points in Y direction. 
-static const int nk = (thickness / grid_size)+1;	 // Spatial points in Z direction. 
+// Size of the simulation grid. These are found from the parameters by
+// LoadParameters. The defaults give ni = 180, nj = 596 and nk = 10.
+static double grid_size; // mm
+static int ni, nj, nk; // Spatial points in the X, Y and Z directions
 
 // The TissueVolume objects in this CellSpace comprise the dynamic part of the model
 static CellSpace<int>* tissue;
+// Count of each cell type in the CellSpace
+static Census* census = NULL;
+// Storage for the TissueVolume objects
+static Arena<TissueVolume>* arena = NULL;
+// Seconds spent creating the model
+static double init_secs = 0.0;
 // The Simulator handles time management, etc.
 static Simulator<CellEvent<int> >* sim;
 // File for parameters not hard coded into the model.
@@ -69,31 +107,223 @@ static std::string inputData = "input.txt";
 static list<double> biopsy;
 // Onset age for be
 static double be_onset;
+// Patient with a packed alternative to the CellSpace and Simulator
+static Patient* patient = NULL;
+// Use the packed grid instead of adevs
+static bool use_grid = false;
+// Report the event rate at the end of the run
+static bool bench = false;
+// Simulate the BE cells as one pool in the packed grid
+static bool aggregate = false;
+// Schedule only expansions that change the packed grid
+static bool frontier = false;
+// Build the grids of a cohort only when the first clone is born
+static bool hybrid = false;
+// Trajectories per stage and replications of a splitting estimate of
+// the incidence of cancer, and the levels of the splitting
+static int split_effort = 0, split_replications = 0;
+static vector<int> split_levels;
+// Replicates of each row of a parameter sweep, the factors that it
+// varies and how the rows are made from them
+static int sweep_replicates = 0;
+static vector<Factor> sweep_factors;
+static const char* design_file = NULL;
+static int factorial_levels = 0, lhs_rows = 0;
+static Design design;
+// End the run at the first cell of a type or a volume of neoplasia
+static Endpoint endpoint;
+static bool use_endpoint = false;
+// Random number seed
+static unsigned long ranseed = 0;
+// Number of patients to simulate in cohort mode
+static int cohort = 0;
+// Grid divided into parts for parallel simulation
+static ParallelTissue* ptissue = NULL;
+// Number of parts around the circumference and along the length
+static int sectors = 1, slabs = 1;
+// Format of the snapshot files and whether to compress them
+static SnapshotWriter::Format format = SnapshotWriter::CSV;
+static bool compress = false;
+// Snapshots between keyframes of the delta format
+static int keyframes = 10;
+// Writes snapshots in the background
+static SnapshotWriter* writer = NULL;
+// Log of every change of type, its file and the years between its counts
+static EventLog* event_log = NULL;
+static const char* log_file = NULL;
+static double log_interval = 0.0;
+// Interval in years for recording the counts of each cell type
+static double count_interval = 0.0;
+// Number of the first multiple of the interval to record. A checkpoint
+// is written before the counts at the same age.
+static int first_count_num = 1;
+// Surveillance protocol and the number of endoscopies at each biopsy age.
+// The protocol is created by LoadParameters from its kind and parameter.
+static Protocol* protocol = NULL;
+static bool use_protocol = false;
+static Protocol::Kind protocol_kind;
+static double protocol_param;
+static int endoscopies = 1000;
+// Length of the BE segment in grid points
+static int BeSize;
+// Stream of random numbers for placing biopsies
+static Random biopsy_rng;
+// File and age for writing a checkpoint. The age is negative if there is none.
+static const char* checkpoint_file = NULL;
+static double checkpoint_age = -1.0;
+// Checkpoint to start from and the snapshot number it stopped at
+static const char* restore_file = NULL;
+static int first_seq_num = 0;
+// Age of the patient when the run starts
+static double start_age = 0.0;
+// Number of futures to simulate from the checkpoint
+static int forks = 0;
+// Parameters given on the command line. These replace the input file.
+static list<pair<string,double> > overrides;
+// Memory budget in MB or zero for none
+static double memory_budget = 0.0;
+// Print the memory estimate and quit
+static bool estimate_only = false;
+
+/**
+ * Get the type of cell at a grid point from whichever engine is in use.
+ */
+static int cell_type(int i, int j, int k)
+{
+	if (ptissue != NULL)
+		return ptissue->itype(i,j,k);
+	if (use_grid)
+		return patient->tissue().itype(i,j,k);
+	return dynamic_cast<TissueVolume*>(tissue->getModel(i,j,k))->itype();
+}
+
+/**
+ * Add the count of each type in the census to types. If snapshot is
+ * not NULL then also copy the cells that are not NORMAL into it. The
+ * census covers the part of the space that starts at x0, y0.
+ */
+static void take_census(const Census& c, int x0, int y0,
+	int types[NUM_CELL_TYPES], Snapshot* snapshot)
+{
+	c.add_counts(types);
+	if (snapshot == NULL)
+		return;
+	for (auto cell : c.non_normal())
+	{
+		int x, y, z;
+		c.position(cell,x,y,z);
+		x += x0; y += y0;
+		snapshot->at(x,y,z) = cell_type(x,y,z);
+	}
+}
+
+/**
+ * Count the cells of each type in whichever engine is in use and copy
+ * those that are not NORMAL into the snapshot if it is not NULL. This
+ * costs O(number of cells that are not NORMAL).
+ */
+static void count_types(int types[NUM_CELL_TYPES], Snapshot* snapshot)
+{
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		types[i] = 0;
+	if (ptissue != NULL)
+	{
+		for (int n = 0; n < ptissue->num_parts(); n++)
+		{
+			const TissueGrid& part = ptissue->part_grid(n);
+			take_census(part.census(),part.xorigin(),part.yorigin(),types,snapshot);
+		}
+	}
+	else if (use_grid)
+		take_census(patient->tissue().census(),0,0,types,snapshot);
+	else
+		take_census(*census,0,0,types,snapshot);
+}
+
+/**
+ * Put the cells that are not NORMAL in whichever engine is in use into
+ * the index and build it.
+ */
+static void build_index(BiopsyIndex& index)
+{
+	index.clear();
+	if (ptissue != NULL)
+	{
+		for (int n = 0; n < ptissue->num_parts(); n++)
+			index.add(ptissue->part_grid(n));
+	}
+	else if (use_grid)
+		index.add(patient->tissue());
+	else
+	{
+		for (auto cell : census->non_normal())
+		{
+			int x, y, z;
+			census->position(cell,x,y,z);
+			index.add(x,y,z,cell_type(x,y,z));
+		}
+	}
+	index.update();
+}
+
+/**
+ * Time of the next event in whichever engine is in use.
+ */
+static double next_event_time()
+{
+	if (ptissue != NULL)
+		return ptissue->nextEventTime();
+	if (use_grid)
+		return patient->tissue().nextEventTime();
+	return sim->nextEventTime();
+}
 
 /**
- * Calculate the length of the BE segment in grid points.
+ * Execute every event up to and including the given age in whichever
+ * engine is in use. Returns the number of events that were executed.
  */
-int calculate_be_length()
-{
-	const double long_be_prob = 0.63;
-	const double long_be_mean = 6.4; // cm
-	const double long_be_std_dev = 3.1; // cm
-	const double short_be_mean = 1.4; // cm
-	const double short_be_std_dev = 0.7; // cm
-	double length; 
-	if (Parameters::getInstance()->uniform() < long_be_prob)
-		length = Parameters::getInstance()->normal(long_be_mean,long_be_std_dev);
+static unsigned long advance(double age)
+{
+	if (ptissue != NULL)
+		return ptissue->execUntil(age-be_onset);
+	if (use_grid)
+		return patient->run_to(age);
+	unsigned long count = 0;
+	while (sim->nextEventTime()+be_onset <= age)
+	{
+		TELEMETRY_TIME_EVENT();
+		sim->execNextEvent();
+		count++;
+	}
+	return count;
+}
+
+#ifdef TELEMETRY
+/**
+ * Number of cells with pending events in the grid engines. The adevs
+ * simulator does not tell us, so this is -1 for it.
+ */
+static long queue_size()
+{
+	long size = 0;
+	if (ptissue != NULL)
+		for (int n = 0; n < ptissue->num_parts(); n++)
+			size += ptissue->part_grid(n).active_cells();
+	else if (patient != NULL)
+		size = patient->tissue().active_cells();
 	else
-		length = Parameters::getInstance()->normal(short_be_mean,short_be_std_dev);
-	if (length < 0.0) length = 0.0;
-	return (int(length*10.0/grid_size)+1);
+		size = -1;
+	return size;
 }
+#endif
 
 /**
- * This data can be visualized using paraview. See 
- * www.paraview.org/Wiki/ParaView/Data_formats
+ * Copy the cell types into a snapshot, report the count of each type,
+ * and pass the snapshot to the writer. The simulation continues while
+ * the file is written. All of the formats can be visualized using
+ * paraview. See www.paraview.org/Wiki/ParaView/Data_formats
  */
-void PrintCSV(int seq_num, double t)
+void PrintSnapshot(int seq_num, double t)
 {
 	assert(NUM_CELL_TYPES == 4);
 	static const char* names[NUM_CELL_TYPES] = {
@@ -102,25 +332,11 @@ void PrintCSV(int seq_num, double t)
 		"dysplasia",
 		"cancer",
 	};
-	int types[NUM_CELL_TYPES] = { 0, 0, 0, 0 };
-	char filename[100];
-	sprintf(filename,"tumor.csv.%d",seq_num);
-	// Output the paraview file format
-	ofstream fout(filename);
-	fout << "xcoord,ycoord,zcoord,type" << endl;
-	for (int i = 0; i < ni; i++)
-		for (int j = 0; j < nj; j++)
-			for (int k = 0; k < nk; k++)
-			{
-				int type =
-					dynamic_cast<TissueVolume*>(tissue->getModel(i,j,k))->itype();
-				types[type]++;
-				if (type >= BE)
-				{
-					fout << i << "," << j << "," << k << "," << type << endl;
-				}
-			}
-	fout.close();
+	int types[NUM_CELL_TYPES];
+	// The snapshot starts out NORMAL, so only the other cells are copied
+	Snapshot* snapshot = new Snapshot(seq_num,t,ni,nj,nk,grid_size);
+	count_types(types,snapshot);
+	writer->write(snapshot);
 	// Report the time and counts of each cell type
 	cout << "t = " << t << endl;
 	for (int i = 0; i < NUM_CELL_TYPES; i++)
@@ -129,44 +345,266 @@ void PrintCSV(int seq_num, double t)
 	}
 }
 
+/**
+ * Append the count of each cell type at age t to the counts file.
+ */
+void PrintCounts(ofstream& fout, double t)
+{
+	int types[NUM_CELL_TYPES];
+	count_types(types,NULL);
+	fout << t;
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		fout << "," << types[i];
+	fout << "\n";
+}
+
+/**
+ * Write the simulation at age t to the checkpoint file. The file holds
+ * the characters ESOCKPT2, the age, the number of the next snapshot, the
+ * biopsy ages that remain, the stream of biopsy locations, and then
+ * the patient.
+ */
+void SaveModel(double t, int seq_num)
+{
+	ofstream fout(checkpoint_file,ios::binary);
+	fout.write("ESOCKPT2",8);
+	save_value(fout,t);
+	save_value(fout,seq_num);
+	save_vector(fout,vector<double>(biopsy.begin(),biopsy.end()));
+	biopsy_rng.save(fout);
+	patient->save(fout);
+	if (!fout.good())
+		cout << "Could not write checkpoint " << checkpoint_file << endl;
+	fout.close();
+}
+
+/**
+ * Read the patient from the checkpoint file and return the age at which
+ * the checkpoint was made. Biopsy ages given on the command line replace
+ * those in the checkpoint. Exits if the checkpoint cannot be read.
+ */
+double RestoreModel(void)
+{
+	ifstream fin(restore_file,ios::binary);
+	char magic[8];
+	double t;
+	vector<double> ages;
+	fin.read(magic,8);
+	if (!fin.good() || memcmp(magic,"ESOCKPT2",8) != 0 ||
+		!load_value(fin,t) || !load_value(fin,first_seq_num) ||
+		!load_vector(fin,ages) || !biopsy_rng.load(fin) ||
+		(patient = Patient::restore(fin)) == NULL)
+	{
+		cout << "Could not read checkpoint " << restore_file << endl;
+		exit(0);
+	}
+	fin.close();
+	if (biopsy.empty())
+		biopsy.assign(ages.begin(),ages.end());
+	// The past cannot be biopsied
+	while (!biopsy.empty() && biopsy.front() < t)
+	{
+		cout << "Ignoring biopsy at age " << biopsy.front() << endl;
+		biopsy.pop_front();
+	}
+	return t;
+}
+
+/**
+ * Perform the endoscopies at age t and append the result to the biopsy
+ * file. The row has the true grade of the tissue that can be reached by
+ * a biopsy, the mean number of biopsies per endoscopy, and the fraction
+ * of endoscopies that found each grade or a more advanced one.
+ */
+void PrintBiopsies(ofstream& fout, BiopsyIndex& index, Random& rng, double t)
+{
+	double detected[NUM_CELL_TYPES];
+	build_index(index);
+	double taken = protocol->sensitivity(index,BeSize,&rng,endoscopies,detected);
+	fout << t << "," << index.worst() << "," << taken;
+	for (int i = BE; i < NUM_CELL_TYPES; i++)
+		fout << "," << detected[i];
+	fout << "\n";
+}
+
+//===========================================================================//
+void LoadParameters(void)
+{
+	Parameters* p = Parameters::getInstance();
+	// Load the free parameters and then the ones from the command line
+	p->load_from_file(inputData.c_str());
+	for (auto o : overrides)
+	{
+		if (!p->set(o.first,o.second))
+		{
+			cout << "Unknown parameter " << o.first << endl;
+			exit(0);
+		}
+	}
+	p->apply();
+	// Get the size of the simulation grid
+	grid_size = p->cell_size();
+	ni = p->xdim();
+	nj = p->ydim();
+	nk = p->zdim();
+	if (use_protocol && (protocol = Protocol::jumbo(protocol_kind,protocol_param,p)) == NULL)
+	{
+		cout << "Illegal protocol parameter " << protocol_param << endl;
+		exit(0);
+	}
+	// Sort the biopsies by age
+	biopsy.sort();
+}
+
+/**
+ * Print the memory that the run will need and make it fit the budget by
+ * switching from adevs to the grid engine or by using fewer threads.
+ * Returns false if it cannot be made to fit.
+ */
+static bool FitMemory(void)
+{
+	const char* names[] = { "adevs", "grid", "parallel" };
+	Engine engine = (sectors*slabs > 1) ? PARALLEL_ENGINE :
+		(use_grid ? GRID_ENGINE : ADEVS_ENGINE);
+	// Each thread of a cohort, forks or splitting has its own patient
+	int threads = (cohort > 0 || forks > 0 || split_effort > 0 || sweep_replicates > 0) ?
+		omp_get_max_threads() : 1;
+	if (cohort > 0 && threads > cohort) threads = cohort;
+	if (forks > 0 && threads > forks) threads = forks;
+	// Splitting keeps the states that passed a level for two stages
+	int kept = (forks > 0) ? 1 : 2*split_effort;
+	// Snapshots are not taken by a cohort, forks, splitting or a sweep.
+	// The delta format keeps a copy of the last one.
+	int snapshots = (cohort > 0 || forks > 0 || split_effort > 0 ||
+		sweep_replicates > 0 || biopsy.empty()) ? 0 :
+		((format == SnapshotWriter::DELTA) ? 4 : 3);
+	// The rows of a sweep can change the size of the grid
+	int nx = ni, ny = nj, nz = nk;
+	if (sweep_replicates > 0)
+		largest_grid(design,nx,ny,nz);
+	MemoryEstimate m = estimate_memory(engine,nx,ny,nz,threads+kept,snapshots);
+	const double budget = memory_budget*1048576.0;
+	if (budget > 0.0 && m.peak > budget && engine == ADEVS_ENGINE)
+	{
+		engine = GRID_ENGINE;
+		use_grid = true;
+		m = estimate_memory(engine,nx,ny,nz,threads+kept,snapshots);
+		cout << "Using the grid engine to fit the memory budget" << endl;
+	}
+	while (budget > 0.0 && m.peak > budget && threads > 1)
+	{
+		threads--;
+		omp_set_num_threads(threads);
+		m = estimate_memory(engine,nx,ny,nz,threads+kept,snapshots);
+	}
+	if (budget > 0.0 || estimate_only)
+	{
+		print_estimate(names[engine],m);
+		if (threads > 1)
+			cout << "threads : " << threads << endl;
+	}
+	if (budget > 0.0 && m.peak > budget)
+	{
+		cout << "The model needs " << m.peak/1048576.0 << " MB but the budget is " <<
+			memory_budget << " MB" << endl;
+		return false;
+	}
+	return true;
+}
+
 //===========================================================================//
 void InitModel(void)
 {
-	// Set the size of the simulation grid
-	Parameters::getInstance()->cell_size(grid_size);
-	Parameters::getInstance()->xdim(ni);
-	Parameters::getInstance()->ydim(nj);
-	Parameters::getInstance()->zdim(nk);
-	// Load the free parameters
-	Parameters::getInstance()->load_from_file(inputData.c_str());
-	// Create the simulation grid
-	tissue = new CellSpace<int>(ni,nj,nk);
-	int BeSize = calculate_be_length();
-	cout << "Segment has length of " << ((double)(BeSize)*grid_size/10.0) << " cm" << endl;
-	cout << "Extends over " << (((double)(BeSize)/(double)(nj))*100.0) << "\% of length" << endl;
-	// Populate it with TissueVolume objects
-	for (int i = 0; i < ni; i++)
+	// Populate the parts of a divided grid
+	if (sectors*slabs > 1)
 	{
+		Random rng(ranseed);
+		BeSize = calculate_be_length(&rng);
+		ptissue = new ParallelTissue(sectors,slabs,ranseed,aggregate);
+		// As in Patient::build, NORMAL cells need clocks only if they
+		// can mutate
+		bool normal_fires = Parameters::getInstance()->get_mutation_interval(NORMAL) <
+			adevs_inf<double>();
+		for (int i = 0; i < ni; i++)
+			for (int j = 0; j < nj; j++)
+				for (int k = 0; k < nk; k++)
+				{
+					if (k == 0 && j < BeSize)
+						ptissue->add(BE,i,j,k);
+					else if (normal_fires)
+						ptissue->add(NORMAL,i,j,k);
+				}
+		be_onset = rng.exponential(Parameters::getInstance()->be_onset_age());
+	}
+	// The patient is read from a checkpoint
+	else if (restore_file != NULL)
+	{
+		double t = RestoreModel();
+		start_age = t;
+		BeSize = patient->be_length();
+		be_onset = patient->be_onset();
+		// Forks start from the checkpoint
+		if (forks > 0 && checkpoint_age < 0.0)
+			checkpoint_age = t;
+		if (count_interval > 0.0)
+			first_count_num = floor(t/count_interval)+1;
+		cout << "Restored at age " << t << endl;
+	}
+	// The patient creates and populates its own grid
+	else if (use_grid)
+	{
+		patient = new Patient(ranseed,aggregate,frontier);
+		BeSize = patient->be_length();
+		be_onset = patient->be_onset();
+		start_age = patient->clone_age();
+	}
+	else
+	{
+		BeSize = calculate_be_length(Parameters::getInstance()->random());
+		// Create the simulation grid
+		tissue = new CellSpace<int>(ni,nj,nk);
+		census = new Census(ni,nj,nk);
+		// Create the TissueVolume objects in parallel in one block of
+		// memory. Each draws its first event times from its own stream,
+		// so the result does not depend on the number of threads.
+		arena = new Arena<TissueVolume>(ni*nj*nk);
+		TissueVolume::use_arena(arena);
+		#pragma omp parallel for schedule(static)
 		for (int j = 0; j < nj; j++)
 		{
 			for (int k = 0; k < nk; k++)
 			{
-				// Top layer has BE
-				if (k == 0 && j < BeSize)
-					tissue->add(new TissueVolume(BE,i,j,k),i,j,k);
-				// Everything else is initially normal
-				else
-					tissue->add(new TissueVolume(NORMAL,i,j,k),i,j,k);
+				for (int i = 0; i < ni; i++)
+				{
+					int cell = census->index(i,j,k);
+					Random init(ranseed,VOXEL_STREAM+cell);
+					// Top layer has BE, everything else is initially normal
+					int iType = (k == 0 && j < BeSize) ? BE : NORMAL;
+					new (arena->slot(cell)) TissueVolume(iType,i,j,k,NULL,NULL,&init);
+				}
 			}
 		}
+		// Populate the CellSpace with them
+		for (int j = 0; j < nj; j++)
+		{
+			for (int k = 0; k < nk; k++)
+			{
+				for (int i = 0; i < ni; i++)
+				{
+					TissueVolume* volume = (TissueVolume*)(arena->slot(census->index(i,j,k)));
+					volume->attach(census);
+					tissue->add(volume,i,j,k);
+				}
+			}
+		}
+		// Get the BE onset age
+		double mean_onset = Parameters::getInstance()->be_onset_age();
+		be_onset = Parameters::getInstance()->exponential(mean_onset);
+		// Create the simulator for our tissue model
+		sim = new Simulator<CellEvent<int> >(tissue);
 	}
-	// Get the BE onset age
-	double mean_onset = Parameters::getInstance()->be_onset_age();
-	be_onset = Parameters::getInstance()->exponential(mean_onset);
-	// Sort the biopsies by age
-	biopsy.sort();
-	// Create the simulator for our tissue model
-	sim = new Simulator<CellEvent<int> >(tissue);
+	cout << "Segment has length of " << ((double)(BeSize)*grid_size/10.0) << " cm" << endl;
+	cout << "Extends over " << (((double)(BeSize)/(double)(nj))*100.0) << "\% of length" << endl;
 }
 
 int main(int argc, char **argv)
@@ -180,9 +618,236 @@ int main(int argc, char **argv)
 		}
 		else if( strcmp( argv[i], "-ranseed" ) == 0 && ++i < argc )
 		{
-			unsigned ranseed = (unsigned)atol( argv[i] );
+			ranseed = (unsigned)atol( argv[i] );
 			Parameters::getInstance()->set_seed(ranseed);
 		}
+		else if (strcmp(argv[i],"-cohort") == 0 && ++i < argc)
+		{
+			cohort = atoi(argv[i]);
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-sectors") == 0 && ++i < argc)
+		{
+			sectors = atoi(argv[i]);
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-slabs") == 0 && ++i < argc)
+		{
+			slabs = atoi(argv[i]);
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-format") == 0 && ++i < argc)
+		{
+			if (!SnapshotWriter::parse_format(argv[i],format))
+			{
+				cout << "Unknown format " << argv[i] << endl;
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i],"-compress") == 0)
+		{
+			compress = true;
+		}
+		else if (strcmp(argv[i],"-keyframes") == 0 && ++i < argc)
+		{
+			keyframes = atoi(argv[i]);
+			if (keyframes < 1)
+			{
+				cout << "Illegal keyframe interval " << argv[i] << endl;
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i],"-counts") == 0 && ++i < argc)
+		{
+			count_interval = atof(argv[i]);
+			if (count_interval <= 0.0)
+			{
+				cout << "Illegal count interval " << argv[i] << endl;
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i],"-log") == 0 && i+2 < argc)
+		{
+			log_file = argv[++i];
+			log_interval = atof(argv[++i]);
+			if (log_interval <= 0.0)
+			{
+				cout << "Illegal log interval " << argv[i] << endl;
+				return 0;
+			}
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-protocol") == 0 && i+2 < argc)
+		{
+			if (!Protocol::parse_kind(argv[++i],protocol_kind))
+			{
+				cout << "Unknown protocol " << argv[i] << endl;
+				return 0;
+			}
+			protocol_param = atof(argv[++i]);
+			use_protocol = true;
+		}
+		else if (strcmp(argv[i],"-set") == 0 && i+2 < argc)
+		{
+			string name = argv[++i];
+			overrides.push_back(pair<string,double>(name,atof(argv[++i])));
+		}
+		else if (strcmp(argv[i],"-memory") == 0 && ++i < argc)
+		{
+			memory_budget = atof(argv[i]);
+			if (memory_budget <= 0.0)
+			{
+				cout << "Illegal memory budget " << argv[i] << endl;
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i],"-estimate") == 0)
+		{
+			estimate_only = true;
+		}
+		else if (strcmp(argv[i],"-checkpoint") == 0 && i+2 < argc)
+		{
+			checkpoint_file = argv[++i];
+			checkpoint_age = atof(argv[++i]);
+			if (checkpoint_age < 0.0)
+			{
+				cout << "Illegal checkpoint age " << argv[i] << endl;
+				return 0;
+			}
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-restore") == 0 && ++i < argc)
+		{
+			restore_file = argv[i];
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-forks") == 0 && ++i < argc)
+		{
+			forks = atoi(argv[i]);
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-endoscopies") == 0 && ++i < argc)
+		{
+			endoscopies = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i],"-bench") == 0)
+		{
+			bench = true;
+		}
+		else if (strcmp(argv[i],"-aggregate") == 0)
+		{
+			aggregate = true;
+		}
+		else if (strcmp(argv[i],"-frontier") == 0)
+		{
+			frontier = true;
+		}
+		else if (strcmp(argv[i],"-hybrid") == 0)
+		{
+			hybrid = true;
+		}
+		else if (strcmp(argv[i],"-split") == 0 && i+2 < argc)
+		{
+			split_effort = atoi(argv[++i]);
+			split_replications = atoi(argv[++i]);
+			if (split_effort < 1 || split_replications < 2)
+			{
+				cout << "-split needs at least 1 trajectory and 2 replications" << endl;
+				return 0;
+			}
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-level") == 0 && ++i < argc)
+		{
+			int level = atoi(argv[i]);
+			if (level < 1 || (!split_levels.empty() && level <= split_levels.back()))
+			{
+				cout << "Levels must be positive and increasing" << endl;
+				return 0;
+			}
+			split_levels.push_back(level);
+		}
+		else if (strcmp(argv[i],"-sweep") == 0 && ++i < argc)
+		{
+			sweep_replicates = atoi(argv[i]);
+			if (sweep_replicates < 1)
+			{
+				cout << "-sweep needs at least 1 replicate" << endl;
+				return 0;
+			}
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-design") == 0 && ++i < argc)
+		{
+			design_file = argv[i];
+		}
+		else if ((strcmp(argv[i],"-vary") == 0 || strcmp(argv[i],"-logvary") == 0) && i+3 < argc)
+		{
+			Factor f;
+			f.log_scale = (strcmp(argv[i],"-logvary") == 0);
+			f.name = argv[++i];
+			f.low = atof(argv[++i]);
+			f.high = atof(argv[++i]);
+			Parameters check;
+			if (!check.set(f.name,0.0))
+			{
+				cout << "Unknown parameter " << f.name << endl;
+				return 0;
+			}
+			if (f.log_scale && (f.low <= 0.0 || f.high <= 0.0))
+			{
+				cout << "-logvary needs a positive range" << endl;
+				return 0;
+			}
+			sweep_factors.push_back(f);
+		}
+		else if (strcmp(argv[i],"-factorial") == 0 && ++i < argc)
+		{
+			factorial_levels = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i],"-lhs") == 0 && ++i < argc)
+		{
+			lhs_rows = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i],"-endpoint") == 0 && ++i < argc)
+		{
+			if (strcmp(argv[i],"dysplasia") == 0)
+				endpoint.type = DYSPLASIA;
+			else if (strcmp(argv[i],"cancer") == 0)
+				endpoint.type = CANCER;
+			else if (strcmp(argv[i],"volume") == 0 && ++i < argc)
+			{
+				endpoint.volume = atof(argv[i]);
+				if (endpoint.volume <= 0.0)
+				{
+					cout << "Illegal endpoint volume " << argv[i] << endl;
+					return 0;
+				}
+			}
+			else if (strcmp(argv[i],"no_events") != 0)
+			{
+				cout << "Unknown endpoint " << argv[i] << endl;
+				return 0;
+			}
+			use_endpoint = true;
+			use_grid = true;
+		}
+		else if (strcmp(argv[i],"-pooled") == 0)
+		{
+			Parameters::getInstance()->pooled_random(true);
+		}
+		else if (strcmp(argv[i],"-engine") == 0 && ++i < argc)
+		{
+			if (strcmp(argv[i],"grid") == 0)
+				use_grid = true;
+			else if (strcmp(argv[i],"adevs") == 0)
+				use_grid = false;
+			else
+			{
+				cout << "Unknown engine " << argv[i] << endl;
+				return 0;
+			}
+		}
 		else  
 		{
 			errno = 0;
@@ -195,25 +860,304 @@ int main(int argc, char **argv)
 			biopsy.push_back(age);
 		}
 	}
+	if ((aggregate || frontier) && !use_grid)
+	{
+		cout << "-aggregate and -frontier require -engine grid" << endl;
+		return 0;
+	}
+	if (sectors < 1 || slabs < 1 || (sectors*slabs > 1 && (frontier || cohort > 0)))
+	{
+		cout << "-sectors and -slabs must be positive and cannot be used with -frontier or -cohort" << endl;
+		return 0;
+	}
+	if ((checkpoint_file != NULL || restore_file != NULL || forks > 0) &&
+		(!use_grid || sectors*slabs > 1 || cohort > 0))
+	{
+		cout << "-checkpoint, -restore and -forks require -engine grid and cannot be used with -sectors, -slabs or -cohort" << endl;
+		return 0;
+	}
+	if (hybrid && cohort <= 0 && sweep_replicates <= 0)
+	{
+		cout << "-hybrid requires -cohort or -sweep" << endl;
+		return 0;
+	}
+	if ((split_effort > 0 && (sectors*slabs > 1 || cohort > 0 || forks > 0 ||
+		checkpoint_file != NULL || restore_file != NULL)) ||
+		(!split_levels.empty() && split_effort == 0))
+	{
+		cout << "-split cannot be used with -sectors, -slabs, -cohort, -checkpoint, -restore or -forks and -level requires -split" << endl;
+		return 0;
+	}
+	if (sweep_replicates > 0 && (sectors*slabs > 1 || cohort > 0 || forks > 0 ||
+		split_effort > 0 || checkpoint_file != NULL || restore_file != NULL))
+	{
+		cout << "-sweep cannot be used with -sectors, -slabs, -cohort, -split, -checkpoint, -restore or -forks" << endl;
+		return 0;
+	}
+	// A sweep has exactly one source of rows and only the factorial and
+	// Latin hypercube designs use the factors
+	int sources = (design_file != NULL)+(factorial_levels != 0)+(lhs_rows != 0);
+	if ((sweep_replicates > 0 && (sources != 1 || (design_file != NULL) != sweep_factors.empty())) ||
+		(sweep_replicates <= 0 && (sources > 0 || !sweep_factors.empty())) ||
+		factorial_levels < 0 || lhs_rows < 0)
+	{
+		cout << "-sweep needs -design, or -vary with -factorial or -lhs" << endl;
+		return 0;
+	}
+	if (use_endpoint && (biopsy.empty() || (!use_grid && cohort <= 0) ||
+		sectors*slabs > 1 || split_effort > 0 || sweep_replicates > 0 ||
+		checkpoint_file != NULL || forks > 0 || (cohort > 0 && use_protocol)))
+	{
+		cout << "-endpoint needs a biopsy age and -engine grid or -cohort, and cannot be used with -sectors, -slabs, -split, -sweep, -checkpoint, -forks or a -cohort with a -protocol" << endl;
+		return 0;
+	}
+	if (log_file != NULL && (!use_grid || sectors*slabs > 1 || cohort > 0 || split_effort > 0 ||
+		sweep_replicates > 0 || forks > 0))
+	{
+		cout << "-log requires -engine grid and cannot be used with -sectors, -slabs, -cohort, -split, -sweep or -forks" << endl;
+		return 0;
+	}
+	if (forks < 0 || (forks > 0 && checkpoint_file == NULL && restore_file == NULL))
+	{
+		cout << "-forks needs a positive count and -checkpoint or -restore" << endl;
+		return 0;
+	}
+	biopsy_rng.set_seed(ranseed,BIOPSY_STREAM);
+	LoadParameters();
+	// The rows of a sweep are needed to estimate its memory
+	if (sweep_replicates > 0)
+	{
+		string error;
+		if (design_file != NULL && !read_design(design_file,design,error))
+		{
+			cout << error << endl;
+			delete protocol;
+			Parameters::deleteInstance();
+			return 0;
+		}
+		if (factorial_levels > 0)
+			design = factorial_design(sweep_factors,factorial_levels);
+		if (lhs_rows > 0)
+			design = latin_hypercube(sweep_factors,lhs_rows,ranseed);
+	}
+	if (!FitMemory() || estimate_only)
+	{
+		delete protocol;
+		Parameters::deleteInstance();
+		return 0;
+	}
+	// Simulate many patients and then quit
+	if (cohort > 0)
+	{
+#ifdef TELEMETRY
+		auto cohort_start = chrono::steady_clock::now();
+#endif
+		if (use_endpoint)
+			run_endpoints(cohort,ranseed,biopsy.back(),endpoint,"endpoints.csv",
+				aggregate,frontier,hybrid);
+		else
+			run_cohort(cohort,ranseed,biopsy,"cohort.csv",aggregate,frontier,hybrid,
+				protocol,endoscopies);
+#ifdef TELEMETRY
+		ofstream json("telemetry.json");
+		telemetry::write_json(json,(biopsy.empty()) ? 0.0 : biopsy.back(),
+			chrono::duration<double>(chrono::steady_clock::now()-cohort_start).count(),-1);
+#endif
+		delete protocol;
+		Parameters::deleteInstance();
+		return 0;
+	}
+	// Estimate the incidence of cancer and then quit
+	if (split_effort > 0)
+	{
+		run_splitting(split_effort,split_replications,ranseed,biopsy,split_levels,
+			"split.csv",aggregate,frontier);
+		delete protocol;
+		Parameters::deleteInstance();
+		return 0;
+	}
+	// Sweep the design and then quit
+	if (sweep_replicates > 0)
+	{
+		run_sweep(design,sweep_replicates,ranseed,biopsy,"sweep.csv",aggregate,
+			frontier,hybrid);
+		delete protocol;
+		Parameters::deleteInstance();
+		return 0;
+	}
 	// Setup the model
+	auto init_start = chrono::steady_clock::now();
 	InitModel();
+	init_secs = chrono::duration<double>(chrono::steady_clock::now()-init_start).count();
+	writer = new SnapshotWriter(format,compress,keyframes);
+	// Log the changes from here on
+	if (log_file != NULL)
+	{
+		event_log = new EventLog(log_file,log_interval,compress);
+		if (!event_log->good())
+		{
+			cout << "Could not open log " << log_file << endl;
+			delete event_log;
+			delete writer;
+			delete protocol;
+			delete patient;
+			Parameters::deleteInstance();
+			return 0;
+		}
+		event_log->start(patient->tissue(),patient->clone_age(),start_age);
+		patient->observe(event_log);
+	}
 	// Run the simulation
-	int seq_num = 0;
-	while (!biopsy.empty())
+	int seq_num = first_seq_num;
+	unsigned long events = 0;
+	// Counts are recorded at every multiple of the interval
+	ofstream counts;
+	int count_num = first_count_num;
+	if (count_interval > 0.0)
+	{
+		counts.open("counts.csv");
+		counts << "age,normal,BE,dysplasia,cancer" << endl;
+	}
+	// Endoscopies use their own stream so they do not change the tissue
+	ofstream biopsies;
+	BiopsyIndex index(ni,nj,(protocol != NULL) ? protocol->biopsy_depth() : 1);
+	if (protocol != NULL)
 	{
+		biopsies.open("biopsy.csv");
+		biopsies << "age,true_grade,biopsies,detect_BE,detect_dysplasia,detect_cancer" << endl;
+	}
+#ifdef TELEMETRY
+	// Telemetry is written at each biopsy and at the end of the run
+	ofstream telemetry_csv("telemetry.csv");
+	telemetry::write_header(telemetry_csv);
+	double last_age = 0.0;
+#endif
+	// A run that does not reach its endpoint ends at the last age
+	double last_biopsy = (biopsy.empty()) ? 0.0 : biopsy.back();
+	auto start = chrono::steady_clock::now();
+	while (!biopsy.empty() || checkpoint_age >= 0.0)
+	{
+		double next_biopsy = (biopsy.empty()) ? adevs_inf<double>() : biopsy.front();
+		double next_count = (count_interval > 0.0) ?
+			count_num*count_interval : adevs_inf<double>();
+		double next_stop = (next_count < next_biopsy) ? next_count : next_biopsy;
+		if (checkpoint_age >= 0.0 && checkpoint_age < next_stop)
+			next_stop = checkpoint_age;
+		// Write the checkpoint and start the forks
+		if (checkpoint_age >= 0.0 && checkpoint_age <= next_stop &&
+			next_event_time()+be_onset > checkpoint_age)
+		{
+			if (checkpoint_file != NULL)
+				SaveModel(checkpoint_age,seq_num);
+			if (forks > 0)
+			{
+				run_forks(*patient,checkpoint_age,forks,biopsy,"forks.csv",
+					protocol,endoscopies);
+				biopsy.clear();
+			}
+			checkpoint_age = -1.0;
+		}
+		// Record the counts
+		else if (next_count <= next_biopsy && next_event_time()+be_onset > next_count)
+		{
+			PrintCounts(counts,next_count);
+			count_num++;
+		}
 		// Take a biopsy
-		if (sim->nextEventTime()+be_onset > biopsy.front())
+		else if (next_event_time()+be_onset > next_biopsy)
 		{
-			PrintCSV(seq_num++,biopsy.front());
+			PrintSnapshot(seq_num++,biopsy.front());
+			if (protocol != NULL)
+				PrintBiopsies(biopsies,index,biopsy_rng,biopsy.front());
+#ifdef TELEMETRY
+			last_age = biopsy.front();
+			telemetry::write_row(telemetry_csv,last_age,
+				chrono::duration<double>(chrono::steady_clock::now()-start).count(),queue_size());
+#endif
 			biopsy.pop_front();
 		}
+		// Advance to the endpoint and stop there
+		else if (use_endpoint)
+		{
+			events += patient->run_to(next_stop,endpoint);
+			if (endpoint.reached())
+				break;
+		}
 		// Otherwise advance the simulation
 		else
-			sim->execNextEvent();
+			events += advance(next_stop);
+	}
+	// Report the endpoint and the random numbers that reproduce it
+	if (use_endpoint)
+	{
+		if (!endpoint.reached())
+			endpoint.age = last_biopsy;
+		cout << "endpoint : " << endpoint.name() << endl;
+		cout << "endpoint age : " << endpoint.age << endl;
+		cout << "seed : " << patient->seed() << endl;
+		cout << "draws : " << patient->draws() << endl;
+	}
+	counts.close();
+	biopsies.close();
+	// Finish writing the log
+	double log_secs = 0.0;
+	unsigned long log_stalls = 0;
+	if (event_log != NULL)
+	{
+		event_log->finish(endpoint.reached() ? endpoint.age : last_biopsy);
+		log_secs = event_log->write_seconds();
+		log_stalls = event_log->stalls();
+		patient->observe(NULL);
+		delete event_log;
+	}
+	// Finish writing the snapshots
+	writer->flush();
+	double write_secs = writer->write_seconds();
+	delete writer;
+#ifdef TELEMETRY
+	{
+		double secs = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+		telemetry::write_row(telemetry_csv,last_age,secs,queue_size());
+		ofstream json("telemetry.json");
+		telemetry::write_json(json,last_age,secs,queue_size());
+	}
+#endif
+	if (bench)
+	{
+		double secs = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+		cout << "engine : " << ((ptissue != NULL) ? "parallel" : (use_grid ? "grid" : "adevs")) << endl;
+		cout << "init seconds : " << init_secs << endl;
+		cout << "events : " << events << endl;
+		cout << "seconds : " << secs << endl;
+		cout << "events/sec : " << ((secs > 0.0) ? events/secs : 0.0) << endl;
+		cout << "ns/event : " << ((events > 0) ? 1E9*secs/events : 0.0) << endl;
+		long rss, peak;
+		process_memory(rss,peak);
+		cout << "peak rss kB : " << peak << endl;
+		cout << "snapshot seconds : " << write_secs << endl;
+		if (log_file != NULL)
+		{
+			cout << "log seconds : " << log_secs << endl;
+			cout << "log stalls : " << log_stalls << endl;
+		}
+		if (patient != NULL)
+			cout << "rows : " << patient->tissue().rows() << " of " << nj << endl;
+		if (ptissue != NULL)
+		{
+			cout << "windows : " << ptissue->windows() << endl;
+			cout << "rollbacks : " << ptissue->rollbacks() << endl;
+			cout << "replays : " << ptissue->replays() << endl;
+		}
 	}
 	// Cleanup
 	delete sim;
+	// The volumes are destroyed with the CellSpace and freed with the arena
 	delete tissue;
+	delete arena;
+	delete census;
+	delete protocol;
+	delete patient;
+	delete ptissue;
 	Parameters::deleteInstance();
 	return 0;
 }
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include "EventLog.h"
+#include "Snapshot.h"
+using namespace std;
+
+/********************************************************************************
+Rebuild the grid from a log written with the -log option of the simulator
+without running the simulation again. The grid at each age on the command
+line is written as tumor.csv.N or another format given with -format,
+numbered from zero in the order of the ages. The -counts option writes the
+counts from the log to counts.csv.
+
+With -series, the numbers on the command line are snapshots of a series
+written with -format delta in the current directory. Each is rebuilt from
+its keyframe and written in the format given with -format, keeping its
+number.
+
+ ./replay tumor.log -format raw -compress 55 60 65
+ ./replay -series -format vti 7 12
+********************************************************************************/
+
+int main(int argc, char **argv)
+{
+	SnapshotWriter::Format format = SnapshotWriter::CSV;
+	bool compress = false, counts = false, series = false;
+	const char* log_file = NULL;
+	vector<double> ages;
+	vector<int> frames;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i],"-format") == 0 && ++i < argc)
+		{
+			if (!SnapshotWriter::parse_format(argv[i],format))
+			{
+				cout << "Unknown format " << argv[i] << endl;
+				return 0;
+			}
+		}
+		else if (strcmp(argv[i],"-compress") == 0)
+			compress = true;
+		else if (strcmp(argv[i],"-counts") == 0)
+			counts = true;
+		else if (strcmp(argv[i],"-series") == 0)
+			series = true;
+		else if (series)
+			frames.push_back(atoi(argv[i]));
+		else if (log_file == NULL)
+			log_file = argv[i];
+		else
+		{
+			double age = atof(argv[i]);
+			if (age <= 0.0 || (!ages.empty() && age < ages.back()))
+			{
+				cout << "Ages must be positive and increasing" << endl;
+				return 0;
+			}
+			ages.push_back(age);
+		}
+	}
+	// Writing a series as a series would replace the files it is read from
+	if (series)
+	{
+		if (format == SnapshotWriter::DELTA)
+		{
+			cout << "A series cannot be written as a series" << endl;
+			return 0;
+		}
+		SnapshotWriter writer(format,compress);
+		for (auto n : frames)
+		{
+			Snapshot* s = read_delta(n);
+			if (s == NULL)
+			{
+				cout << "Could not read snapshot " << n << " of the series" << endl;
+				return 0;
+			}
+			writer.write(s);
+		}
+		return 0;
+	}
+	if (log_file == NULL)
+	{
+		cout << "Usage: replay LOG [-format csv|raw|vti|delta] [-compress] [-counts] AGE ..." << endl;
+		cout << "       replay -series [-format csv|raw|vti] [-compress] N ..." << endl;
+		return 0;
+	}
+	EventLogReader reader(log_file);
+	if (!reader.good())
+	{
+		cout << "Could not read log " << log_file << endl;
+		return 0;
+	}
+	SnapshotWriter writer(format,compress);
+	for (unsigned n = 0; n < ages.size(); n++)
+		writer.write(reader.frame(n,ages[n]));
+	writer.flush();
+	if (counts)
+	{
+		// Read the rest of the log for its counts
+		delete reader.frame(0,adevs_inf<double>());
+		ofstream fout("counts.csv");
+		fout << "age,normal,BE,dysplasia,cancer" << endl;
+		for (auto c : reader.counts())
+		{
+			fout << c.age;
+			for (int i = 0; i < NUM_CELL_TYPES; i++)
+				fout << "," << c.types[i];
+			fout << "\n";
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Strong scaling of the parallel engine for one patient.
+# Usage: ./scaling.sh SECTORS SLABS AGE [other a.out arguments]
+# Prints the thread count, seconds, and speedup for 1, 2, 4, ... 64 threads.
+sectors=$1; slabs=$2; age=$3
+shift 3
+base=""
+for threads in 1 2 4 8 16 32 64
+do
+	secs=`OMP_NUM_THREADS=$threads ./a.out -bench -sectors $sectors -slabs $slabs "$@" $age | grep "^seconds" | cut -d' ' -f3`
+	if [ -z "$base" ]; then base=$secs; fi
+	echo "$threads $secs `echo "$base / $secs" | bc -l`"
+done
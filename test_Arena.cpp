@@ -0,0 +1,59 @@
+#include "Arena.h"
+#include <cassert>
+#include <iostream>
+using namespace std;
+
+static int live = 0;
+
+/**
+ * An object that counts how many of it exist and is not freed one at a
+ * time if it is in the arena.
+ */
+struct Counted
+{
+	static const Arena<Counted>* arena;
+	double value;
+	int id;
+	Counted(int id):value(id*0.5),id(id) { live++; }
+	~Counted() { live--; }
+	static void operator delete(void* p)
+	{
+		if (arena == NULL || !arena->owns(p))
+			::operator delete(p);
+	}
+};
+
+const Arena<Counted>* Counted::arena = NULL;
+
+void test_arena()
+{
+	cout << "TEST ARENA" << endl;
+	const int count = 100000;
+	Arena<Counted>* arena = new Arena<Counted>(count);
+	Counted::arena = arena;
+	#pragma omp parallel for
+	for (int i = 0; i < count; i++)
+		new (arena->slot(i)) Counted(i);
+	assert(live == count);
+	for (int i = 0; i < count; i++)
+	{
+		Counted* c = (Counted*)(arena->slot(i));
+		assert(c->id == i && c->value == i*0.5 && arena->owns(c));
+	}
+	// Objects outside the arena are freed as usual
+	Counted* outside = new Counted(-1);
+	assert(!arena->owns(outside));
+	delete outside;
+	for (int i = 0; i < count; i++)
+		delete (Counted*)(arena->slot(i));
+	assert(live == 0);
+	delete arena;
+	Counted::arena = NULL;
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_arena();
+	return 0;
+}
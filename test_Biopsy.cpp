@@ -0,0 +1,86 @@
+#include "Biopsy.h"
+#include <cassert>
+#include <iostream>
+using namespace std;
+
+const int nx = 20, ny = 30, depth = 3;
+
+/**
+ * Compare biopsies against a direct count of the columns in a grid with
+ * randomly placed cells.
+ */
+void test_sample()
+{
+	cout << "TEST SAMPLE" << endl;
+	Random rng(1);
+	vector<int> grade(nx*ny,NORMAL);
+	BiopsyIndex index(nx,ny,depth);
+	for (int n = 0; n < 200; n++)
+	{
+		int x = rng.uniform_int(nx), y = rng.uniform_int(ny),
+			z = rng.uniform_int(2*depth), iType = 1+rng.uniform_int(3);
+		index.add(x,y,z,iType);
+		if (z < depth && iType > grade[y*nx+x])
+			grade[y*nx+x] = iType;
+	}
+	index.update();
+	for (int n = 0; n < 10000; n++)
+	{
+		int x = rng.uniform_int(2*nx)-nx/2, y = rng.uniform_int(ny+10)-5,
+			w = 1+rng.uniform_int(nx), l = 1+rng.uniform_int(10);
+		int found[NUM_CELL_TYPES], expect[NUM_CELL_TYPES] = { 0, 0, 0, 0 };
+		int worst = index.sample(x,y,w,l,found), expect_worst = -1;
+		for (int j = y; j < y+l; j++)
+		{
+			if (j < 0 || j >= ny)
+				continue;
+			for (int i = x; i < x+w; i++)
+			{
+				int g = grade[j*nx+(i+nx)%nx];
+				expect[g]++;
+				if (g > expect_worst) expect_worst = g;
+			}
+		}
+		assert(worst == expect_worst);
+		for (int g = 0; g < NUM_CELL_TYPES; g++)
+			assert(found[g] == expect[g]);
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+void test_protocol()
+{
+	cout << "TEST PROTOCOL" << endl;
+	Random rng(2);
+	BiopsyIndex index(nx,ny,depth);
+	// Cancer covers the whole segment so every endoscopy finds it
+	for (int x = 0; x < nx; x++)
+		for (int y = 0; y < 10; y++)
+			index.add(x,y,0,CANCER);
+	index.update();
+	assert(index.worst() == CANCER);
+	double detected[NUM_CELL_TYPES];
+	Protocol seattle(Protocol::SEATTLE,4,3,2,depth);
+	double taken = seattle.sensitivity(index,10,&rng,100,detected);
+	assert(taken >= 8.0 && taken <= 12.0);
+	assert(detected[CANCER] == 1.0);
+	// Nothing can be found outside the segment
+	Protocol random(Protocol::RANDOM,5,3,2,depth);
+	index.clear();
+	index.add(0,20,0,DYSPLASIA);
+	index.update();
+	assert(random.sensitivity(index,10,&rng,100,detected) == 5.0);
+	assert(detected[NORMAL] == 1.0 && detected[DYSPLASIA] == 0.0);
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	Parameters* p = Parameters::getInstance();
+	p->xdim(nx);
+	p->ydim(ny);
+	p->zdim(2*depth);
+	test_sample();
+	test_protocol();
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include "Census.h"
+#include <cassert>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+const int nx = 7, ny = 11, nz = 3;
+
+/**
+ * Compare the census against a full count of a grid while cells change
+ * type in random order.
+ */
+void test_random_changes()
+{
+	cout << "TEST RANDOM CHANGES" << endl;
+	Census c(nx,ny,nz);
+	vector<int> cells(nx*ny*nz,NORMAL);
+	srand(1);
+	for (int i = 0; i < 100000; i++)
+	{
+		int cell = rand()%cells.size();
+		int newType = rand()%NUM_CELL_TYPES;
+		c.change(cell,cells[cell],newType);
+		cells[cell] = newType;
+		if (i%1000 != 0)
+			continue;
+		int types[NUM_CELL_TYPES] = { 0, 0, 0, 0 };
+		vector<int> live;
+		for (unsigned j = 0; j < cells.size(); j++)
+		{
+			types[cells[j]]++;
+			if (cells[j] != NORMAL)
+				live.push_back(j);
+		}
+		for (int t = 0; t < NUM_CELL_TYPES; t++)
+			assert(c.count(t) == types[t]);
+		vector<int> found(c.non_normal());
+		sort(found.begin(),found.end());
+		assert(found == live);
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+void test_position()
+{
+	cout << "TEST POSITION" << endl;
+	Census c(nx,ny,nz);
+	for (int x = 0; x < nx; x++)
+		for (int y = 0; y < ny; y++)
+			for (int z = 0; z < nz; z++)
+			{
+				int xx, yy, zz;
+				c.position(c.index(x,y,z),xx,yy,zz);
+				assert(x == xx && y == yy && z == zz);
+			}
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_position();
+	test_random_changes();
+	return 0;
+}
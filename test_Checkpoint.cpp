@@ -0,0 +1,121 @@
+#include "Patient.h"
+#include <cassert>
+#include <sstream>
+#include <iostream>
+using namespace std;
+
+const int nx = 20, ny = 40, nz = 5;
+
+void test_random()
+{
+	cout << "TEST RANDOM" << endl;
+	Random a(7,3);
+	for (int i = 0; i < 13; i++)
+		a.uniform();
+	stringstream buf;
+	a.save(buf);
+	Random b;
+	assert(b.load(buf));
+	assert(a.position() == b.position() && a.position() > 0);
+	for (int i = 0; i < 100; i++)
+		assert(a.uniform() == b.uniform());
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * A restored patient must have exactly the same future as the original
+ * and a fork must have a different one.
+ */
+void test_patient(bool aggregate, bool frontier, bool hybrid = false)
+{
+	cout << "TEST PATIENT " << aggregate << " " << frontier << " " << hybrid << endl;
+	Patient original(3,aggregate,frontier,hybrid);
+	// A hybrid patient has a grid only after the birth of its clone
+	double age = (hybrid) ? original.clone_age()+1.0 : original.be_onset()+2.0;
+	original.run_to(age);
+	assert(original.spatial());
+	stringstream buf;
+	original.save(buf);
+	Patient* restored = Patient::restore(buf);
+	assert(restored != NULL && restored->clone_age() == original.clone_age());
+	Patient fork(original,FORK_STREAM,age);
+	assert(original.run_to(age+6.0) == restored->run_to(age+6.0));
+	fork.run_to(age+6.0);
+	int a[NUM_CELL_TYPES], b[NUM_CELL_TYPES];
+	original.count(a);
+	restored->count(b);
+	bool differ = false;
+	for (int x = 0; x < nx; x++)
+		for (int y = 0; y < ny; y++)
+			for (int z = 0; z < nz; z++)
+			{
+				assert(original.tissue().itype(x,y,z) == restored->tissue().itype(x,y,z));
+				differ = differ || (original.tissue().itype(x,y,z) != fork.tissue().itype(x,y,z));
+			}
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		assert(a[i] == b[i]);
+	assert(a[DYSPLASIA] > 0 && differ);
+	delete restored;
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * A run must end with the event that reaches the endpoint and leave the
+ * patient where a run to that age without an endpoint would be.
+ */
+void test_endpoint(bool hybrid)
+{
+	cout << "TEST ENDPOINT " << hybrid << endl;
+	Patient a(5,false,false,hybrid), b(5,false,false,hybrid);
+	Endpoint end(DYSPLASIA);
+	a.run_to(200.0,end);
+	assert(end.reason == Endpoint::FIRST_CELL && end.age < 200.0);
+	b.run_to(end.age);
+	assert(a.draws() == b.draws() && a.next_event() == b.next_event());
+	int ta[NUM_CELL_TYPES], tb[NUM_CELL_TYPES];
+	a.count(ta);
+	b.count(tb);
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+		assert(ta[i] == tb[i]);
+	assert(ta[DYSPLASIA] == 1);
+	// A volume larger than the grid ends at the last age
+	Endpoint big(-1,1E9);
+	a.run_to(end.age+1.0,big);
+	assert(!big.reached());
+	cout << "TEST PASSED" << endl;
+}
+
+void test_bad_checkpoint()
+{
+	cout << "TEST BAD CHECKPOINT" << endl;
+	Patient original(3);
+	stringstream buf;
+	original.save(buf);
+	string data = buf.str();
+	stringstream truncated(data.substr(0,data.size()/2));
+	assert(Patient::restore(truncated) == NULL);
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	Parameters* p = Parameters::getInstance();
+	p->cell_size(1.0);
+	p->set_stem_cells_per_mm2(10.0);
+	p->xdim(nx);
+	p->ydim(ny);
+	p->zdim(nz);
+	p->be_onset_age(10.0);
+	p->set_diffusion_rate(0.5);
+	p->set_mutations_per_year(0.001,BE);
+	p->set_mutations_per_year(0.00001,DYSPLASIA);
+	test_random();
+	test_patient(false,false);
+	test_patient(true,false);
+	test_patient(true,true);
+	test_patient(true,true,true);
+	test_endpoint(false);
+	test_endpoint(true);
+	test_bad_checkpoint();
+	return 0;
+}
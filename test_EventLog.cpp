@@ -0,0 +1,153 @@
+#include "EventLog.h"
+#include "Patient.h"
+#include <cassert>
+#include <cstdio>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+const int nx = 20, ny = 40, nz = 5;
+
+/**
+ * Every item must arrive once and in order when the producer and
+ * consumer run at the same time on a buffer much smaller than the
+ * number of items.
+ */
+void test_ring_buffer()
+{
+	cout << "TEST RING BUFFER" << endl;
+	RingBuffer<long> ring(100);
+	assert(ring.capacity() == 128);
+	const long items = 1000000;
+	std::thread consumer([&ring]()
+		{
+			long next = 0, item;
+			while (next < items)
+			{
+				if (ring.pop(item))
+					assert(item == next++);
+				else std::this_thread::yield();
+			}
+		});
+	for (long i = 0; i < items; i++)
+		while (!ring.push(i))
+			std::this_thread::yield();
+	consumer.join();
+	long item;
+	assert(!ring.pop(item));
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * Copy the grid of a patient into a snapshot.
+ */
+Snapshot* grid_snapshot(const Patient& patient, int seq_num, double age)
+{
+	Snapshot* s = new Snapshot(seq_num,age,nx,ny,nz,1.0);
+	for (int x = 0; x < nx; x++)
+		for (int y = 0; y < ny; y++)
+			for (int z = 0; z < nz; z++)
+				s->at(x,y,z) = patient.tissue().itype(x,y,z);
+	return s;
+}
+
+/**
+ * The grid rebuilt from the log must be the grid of the patient at
+ * every age and the logged counts must be its counts.
+ */
+void test_replay(bool compress)
+{
+	cout << "TEST REPLAY " << compress << endl;
+	Patient patient(3,true);
+	// Counts are logged at whole years
+	const double start = ceil(patient.be_onset());
+	const double ages[3] = { start+5.0, start+10.0, start+15.0 };
+	// The capacity is small enough that the buffer fills
+	EventLog* log = new EventLog("test_event.log",1.0,compress,64);
+	assert(log->good());
+	log->start(patient.tissue(),patient.clone_age(),patient.clone_age());
+	patient.observe(log);
+	vector<Snapshot*> expected;
+	vector<vector<int> > counts;
+	for (int a = 0; a < 3; a++)
+	{
+		patient.run_to(ages[a]);
+		expected.push_back(grid_snapshot(patient,a,ages[a]));
+		vector<int> c(NUM_CELL_TYPES);
+		patient.count(c.data());
+		counts.push_back(c);
+	}
+	log->finish(ages[2]);
+	delete log;
+	EventLogReader reader("test_event.log");
+	assert(reader.good());
+	for (int a = 0; a < 3; a++)
+	{
+		Snapshot* s = reader.frame(a,ages[a]);
+		assert(s->types == expected[a]->types && s->dx == 1.0);
+		delete s;
+		delete expected[a];
+		// The last counts read are at this age
+		const EventLogReader::Counts& c = reader.counts().back();
+		assert(c.age == ages[a]);
+		for (int i = 0; i < NUM_CELL_TYPES; i++)
+			assert(c.types[i] == counts[a][i]);
+	}
+	assert(counts[2][DYSPLASIA] > 0);
+	remove("test_event.log");
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * A log started after the grid has run, as it is after a restore, must
+ * begin with the grid at that age and have no counts before it.
+ */
+void test_late_start()
+{
+	cout << "TEST LATE START" << endl;
+	Patient patient(3,true);
+	const double start = ceil(patient.be_onset())+5.0;
+	patient.run_to(start);
+	Snapshot* first = grid_snapshot(patient,0,start);
+	EventLog* log = new EventLog("test_event.log",1.0,false);
+	assert(log->good());
+	log->start(patient.tissue(),patient.clone_age(),start);
+	patient.observe(log);
+	patient.run_to(start+5.0);
+	Snapshot* last = grid_snapshot(patient,1,start+5.0);
+	log->finish(start+5.0);
+	delete log;
+	EventLogReader reader("test_event.log");
+	assert(reader.good());
+	Snapshot* s = reader.frame(0,start);
+	assert(s->types == first->types);
+	assert(reader.counts().empty());
+	delete s;
+	s = reader.frame(1,start+5.0);
+	assert(s->types == last->types);
+	assert(reader.counts().size() == 5 && reader.counts().front().age == start+1.0);
+	delete s;
+	delete first;
+	delete last;
+	remove("test_event.log");
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	Parameters* p = Parameters::getInstance();
+	p->cell_size(1.0);
+	p->set_stem_cells_per_mm2(10.0);
+	p->xdim(nx);
+	p->ydim(ny);
+	p->zdim(nz);
+	p->be_onset_age(10.0);
+	p->set_diffusion_rate(0.5);
+	p->set_mutations_per_year(0.001,BE);
+	p->set_mutations_per_year(0.00001,DYSPLASIA);
+	test_ring_buffer();
+	test_replay(false);
+	test_replay(true);
+	test_late_start();
+	return 0;
+}
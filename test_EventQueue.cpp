@@ -0,0 +1,79 @@
+#include "EventQueue.h"
+#include <cassert>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <iostream>
+using namespace std;
+
+/**
+ * Compare the queue against a map of cells to clocks while cells are
+ * inserted, reset, removed, and popped in random order.
+ */
+void test_random_ops()
+{
+	cout << "TEST RANDOM OPS" << endl;
+	EventQueue q;
+	map<int,pair<double,double> > ref;
+	srand(1);
+	for (int i = 0; i < 100000; i++)
+	{
+		int cell = rand()%500;
+		int op = rand()%4;
+		double tm = rand()/(double)RAND_MAX, te = rand()/(double)RAND_MAX;
+		if (op < 2)
+		{
+			q.set(cell,tm,te);
+			ref[cell] = make_pair(tm,te);
+		}
+		else if (op == 2)
+		{
+			q.remove(cell);
+			ref.erase(cell);
+		}
+		else if (!ref.empty())
+		{
+			int least = ref.begin()->first;
+			for (auto r : ref)
+				if (fmin(r.second.first,r.second.second) <
+					fmin(ref[least].first,ref[least].second))
+					least = r.first;
+			assert(q.top().cell == least);
+			q.remove(least);
+			ref.erase(least);
+		}
+		assert(q.size() == ref.size());
+		const EventQueue::Entry* e = q.find(cell);
+		assert((e == NULL) == (ref.count(cell) == 0));
+		if (e != NULL)
+			assert(e->tm == ref[cell].first && e->te == ref[cell].second);
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+void test_order()
+{
+	cout << "TEST ORDER" << endl;
+	EventQueue q;
+	for (int i = 0; i < 1000; i++)
+		q.set(i,(i*7919)%1000,2000.0);
+	// Move one cell to the front and another to the back
+	q.set(500,-1.0,2000.0);
+	q.set(0,5000.0,6000.0);
+	double last = -2.0;
+	while (!q.empty())
+	{
+		assert(q.top().t() >= last);
+		last = q.top().t();
+		q.remove(q.top().cell);
+	}
+	assert(last == 5000.0);
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_order();
+	test_random_ops();
+	return 0;
+}
@@ -0,0 +1,249 @@
+#include "Random.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+using namespace std;
+
+/**
+ * Known answers for Philox4x32-10 from the Random123 distribution.
+ */
+void test_philox()
+{
+	cout << "TEST PHILOX" << endl;
+	const uint32_t ctr[3][4] = {
+		{ 0, 0, 0, 0 },
+		{ 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+		{ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }
+	};
+	const uint32_t key[3][2] = {
+		{ 0, 0 },
+		{ 0xffffffff, 0xffffffff },
+		{ 0xa4093822, 0x299f31d0 }
+	};
+	const uint32_t expect[3][4] = {
+		{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 },
+		{ 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd },
+		{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }
+	};
+	for (int i = 0; i < 3; i++)
+	{
+		uint32_t out[4];
+		Random::philox(ctr[i],key[i],out);
+		for (int j = 0; j < 4; j++)
+			assert(out[j] == expect[i][j]);
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * Streams with the same seed and stream number are identical and
+ * changing either one gives a different stream.
+ */
+void test_streams()
+{
+	cout << "TEST STREAMS" << endl;
+	Random a(7,3), b(7,3), c(7,4), d(8,3);
+	int same_c = 0, same_d = 0;
+	for (int i = 0; i < 1000; i++)
+	{
+		double u = a.uniform();
+		assert(u == b.uniform());
+		if (u == c.uniform()) same_c++;
+		if (u == d.uniform()) same_d++;
+	}
+	assert(same_c < 5 && same_d < 5);
+	// Copies continue from the same place
+	Random e(a);
+	for (int i = 0; i < 10; i++)
+		assert(e.uniform() == a.uniform());
+	// Restarting the stream repeats it
+	b.set_seed(7,3);
+	a.set_seed(7,3);
+	for (int i = 0; i < 10; i++)
+		assert(a.uniform() == b.uniform());
+	cout << "TEST PASSED" << endl;
+}
+
+void test_uniform_int()
+{
+	cout << "TEST UNIFORM INT" << endl;
+	Random r(1);
+	int bins[6] = { 0, 0, 0, 0, 0, 0 };
+	int count = 6000000;
+	for (int i = 0; i < count; i++)
+	{
+		unsigned long k = r.uniform_int(6);
+		assert(k < 6);
+		bins[k]++;
+	}
+	for (int i = 0; i < 6; i++)
+		assert(fabs(bins[i]-count/6.0) < 5.0*sqrt(count/6.0));
+	cout << "TEST PASSED" << endl;
+}
+
+void test_normal()
+{
+	cout << "TEST NORMAL" << endl;
+	Random r(2);
+	double sum = 0.0, sum2 = 0.0;
+	int count = 1000000;
+	for (int i = 0; i < count; i++)
+	{
+		double x = r.normal(3.0,4.0);
+		sum += x;
+		sum2 += x*x;
+	}
+	double mean = sum/count, var = sum2/count-mean*mean;
+	cout << "Got mean = " << mean << " and variance = " << var << endl;
+	// The spread is the square root of the std_dev argument
+	assert(fabs(mean-3.0) < 0.01);
+	assert(fabs(var-4.0) < 0.03);
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * Blocks made in bulk are the same as blocks made one at a time,
+ * including the carry into the second word of the counter.
+ */
+void test_blocks()
+{
+	cout << "TEST BLOCKS" << endl;
+	const uint32_t key[2] = { 0xa4093822, 0x299f31d0 };
+	uint32_t ctr[4] = { 0xfffffff0, 5, 7, 9 };
+	uint32_t bulk[4*32], one[4];
+	Random::philox_blocks(ctr,key,32,bulk);
+	for (int i = 0; i < 32; i++)
+	{
+		Random::philox(ctr,key,one);
+		for (int j = 0; j < 4; j++)
+			assert(bulk[4*i+j] == one[j]);
+		if (++ctr[0] == 0) ++ctr[1];
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+void test_log()
+{
+	cout << "TEST LOG" << endl;
+	Random r(3);
+	const int n = 100000;
+	double* x = new double[n];
+	double* y = new double[n];
+	// The ends of the range used by the exponential pool and then
+	// values spread over many binades
+	x[0] = 1.0;
+	x[1] = ldexp(1.0,-32);
+	x[2] = 1.0-ldexp(1.0,-32);
+	for (int i = 3; i < n; i++)
+		x[i] = ldexp(0.5+0.5*r.uniform(),(int)r.uniform_int(200)-100);
+	Random::log_array(x,y,n);
+	double worst = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		double err = fabs(y[i]-log(x[i]));
+		if (log(x[i]) != 0.0)
+			err /= fabs(log(x[i]));
+		if (err > worst) worst = err;
+	}
+	cout << "Worst relative error = " << worst << endl;
+	assert(y[0] == 0.0);
+	assert(worst < 1E-15);
+	delete [] x;
+	delete [] y;
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * The pooled stream gives the same distributions that test_common
+ * checks for the stream without pools.
+ */
+void test_pooled()
+{
+	cout << "TEST POOLED" << endl;
+	Random r(4,2);
+	r.pool(true);
+	assert(r.pooled());
+	const double mean = 2.0;
+	double sum = 0.0, sum2 = 0.0;
+	int count = 10000000;
+	for (int i = 0; i < count; i++)
+	{
+		double x = r.exponential(mean);
+		assert(x >= 0.0);
+		sum += x;
+		sum2 += x*x;
+	}
+	double m = sum/count, var = sum2/count-m*m;
+	cout << "Got mean = " << m << " and variance = " << var << endl;
+	assert(fabs(m-mean) < 5.0*mean/sqrt((double)count));
+	assert(fabs(var-mean*mean) < 0.01*mean*mean);
+	int bins6[6] = { 0, 0, 0, 0, 0, 0 }, bins4[4] = { 0, 0, 0, 0 };
+	count = 6000000;
+	for (int i = 0; i < count; i++)
+	{
+		int dx, dy, dz;
+		r.direction(dx,dy,dz);
+		assert(abs(dx)+abs(dy)+abs(dz) == 1);
+		bins6[(dx != 0) ? (dx > 0 ? 0 : 1) : (dy != 0 ? (dy > 0 ? 2 : 3) : (dz > 0 ? 4 : 5))]++;
+		r.direction(dx,dy);
+		assert(abs(dx)+abs(dy) == 1);
+		bins4[(dx != 0) ? (dx > 0 ? 0 : 1) : (dy > 0 ? 2 : 3)]++;
+	}
+	for (int i = 0; i < 6; i++)
+		assert(fabs(bins6[i]-count/6.0) < 5.0*sqrt(count/6.0));
+	for (int i = 0; i < 4; i++)
+		assert(fabs(bins4[i]-count/4.0) < 5.0*sqrt(count/4.0));
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * A stream without pools is not changed by them and a pooled stream
+ * continues from a checkpoint.
+ */
+void test_pool_state()
+{
+	cout << "TEST POOL STATE" << endl;
+	// Offsets in the order used by direction
+	const int offsets[6][3] = {
+		{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	Random a(5,1), b(5,1);
+	for (int i = 0; i < 1000; i++)
+	{
+		int dx, dy, dz;
+		a.direction(dx,dy,dz);
+		const int* d = offsets[b.uniform_int(6)];
+		assert(dx == d[0] && dy == d[1] && dz == d[2]);
+		assert(a.exponential(1.0) == -log1p(-b.uniform()));
+	}
+	a.pool(true);
+	for (int i = 0; i < 100; i++)
+		a.exponential(1.0);
+	stringstream buf;
+	a.save(buf);
+	Random c;
+	assert(c.load(buf) && c.pooled());
+	for (int i = 0; i < 1000; i++)
+	{
+		int dx, dy, dz, ex, ey, ez;
+		assert(a.exponential(1.0) == c.exponential(1.0));
+		a.direction(dx,dy,dz);
+		c.direction(ex,ey,ez);
+		assert(dx == ex && dy == ey && dz == ez);
+		assert(a.uniform() == c.uniform());
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_philox();
+	test_streams();
+	test_uniform_int();
+	test_normal();
+	test_blocks();
+	test_log();
+	test_pooled();
+	test_pool_state();
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "Rules.h"
+#include <cassert>
+#include <iostream>
+using namespace std;
+
+/**
+ * The default rules must be the rules of the original model.
+ */
+void test_esophagus()
+{
+	cout << "TEST ESOPHAGUS RULES" << endl;
+	for (int i = 0; i < NUM_CELL_TYPES; i++)
+	{
+		assert(EsophagusRules::mutates_to(i) == ((i < CANCER) ? i+1 : CANCER));
+		assert(EsophagusRules::can_expand(i) == (i == DYSPLASIA || i == CANCER));
+		for (int j = 0; j < NUM_CELL_TYPES; j++)
+			assert(EsophagusRules::can_invade(i,j,0) ==
+				(i > j && (i == CANCER || (j == BE && i == DYSPLASIA))));
+	}
+	assert(EsophagusRules::stencil_size(DYSPLASIA) == 4);
+	assert(EsophagusRules::stencil_size(CANCER) == 6);
+	// The same order as Random::direction
+	Random rng;
+	for (int i = 0; i < 1000; i++)
+	{
+		int dx, dy, dz;
+		Random copy(rng);
+		rng.direction(dx,dy,dz);
+		const int* o = EsophagusRules::offset(copy.direction(6));
+		assert(o[0] == dx && o[1] == dy && o[2] == dz);
+	}
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * A stencil must hold each of its directions once, the opposite of each,
+ * and the surface directions first.
+ */
+template <class Rules> void check_stencil()
+{
+	for (int d = 0; d < Rules::MAX_STENCIL; d++)
+	{
+		const int* o = Rules::offset(d);
+		assert(o[0] != 0 || o[1] != 0 || o[2] != 0);
+		assert((o[2] == 0) == (d < Rules::stencil_size(DYSPLASIA)));
+		int opposite = 0;
+		for (int e = 0; e < Rules::MAX_STENCIL; e++)
+		{
+			const int* q = Rules::offset(e);
+			assert(e == d || q[0] != o[0] || q[1] != o[1] || q[2] != o[2]);
+			if (q[0] == -o[0] && q[1] == -o[1] && q[2] == -o[2])
+				opposite++;
+		}
+		assert(opposite == 1);
+	}
+	assert(Rules::stencil_size(CANCER) == Rules::MAX_STENCIL);
+}
+
+void test_stencils()
+{
+	cout << "TEST STENCILS" << endl;
+	check_stencil<EsophagusRules>();
+	check_stencil<MooreRules>();
+	assert(MooreRules::stencil_size(DYSPLASIA) == 8);
+	cout << "TEST PASSED" << endl;
+}
+
+void test_confined()
+{
+	cout << "TEST CONFINED RULES" << endl;
+	for (int z = 0; z < 10; z++)
+		assert(ConfinedRules<5>::can_invade(CANCER,NORMAL,z) == (z < 5));
+	assert(!ConfinedRules<5>::can_invade(DYSPLASIA,NORMAL,0));
+	assert(ConfinedRules<5>::can_invade(DYSPLASIA,BE,0));
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_esophagus();
+	test_stencils();
+	test_confined();
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include "Snapshot.h"
+#include "common.h"
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+using namespace std;
+
+const int nx = 30, ny = 20, nz = 7;
+
+/**
+ * Every snapshot of a delta series must be rebuilt exactly, in any
+ * order, and the files between keyframes must hold only the changes.
+ */
+void test_delta(bool compress)
+{
+	cout << "TEST DELTA " << compress << endl;
+	const int frames = 11, keyframes = 4;
+	Random rng(1);
+	vector<vector<unsigned char> > expected;
+	vector<unsigned char> types(nx*ny*nz,NORMAL);
+	{
+		SnapshotWriter writer(SnapshotWriter::DELTA,compress,keyframes);
+		for (int n = 0; n < frames; n++)
+		{
+			// Change a few cells and the last one, which is past the
+			// last whole word of eight cells
+			for (int k = 0; k < 5; k++)
+				types[rng.uniform_int(types.size())] = rng.uniform_int(NUM_CELL_TYPES);
+			types.back() = n%NUM_CELL_TYPES;
+			Snapshot* s = new Snapshot(n,30.0+n,nx,ny,nz,0.5);
+			s->types = types;
+			expected.push_back(types);
+			writer.write(s);
+		}
+	}
+	for (int n = frames-1; n >= 0; n--)
+	{
+		Snapshot* s = read_delta(n);
+		assert(s != NULL);
+		assert(s->seq_num == n && s->t == 30.0+n && s->dx == 0.5);
+		assert(s->nx == nx && s->ny == ny && s->nz == nz);
+		assert(s->types == expected[n]);
+		delete s;
+	}
+	// A delta file is much smaller than a keyframe
+	char filename[100];
+	for (int n = 0; n < frames; n++)
+	{
+		sprintf(filename,(compress) ? "tumor.delta.%d.gz" : "tumor.delta.%d",n);
+		FILE* fin = fopen(filename,"rb");
+		assert(fin != NULL);
+		fseek(fin,0,SEEK_END);
+		long size = ftell(fin);
+		fclose(fin);
+		if (!compress && n%keyframes == 0)
+			assert(size == 40+nx*ny*nz);
+		else if (!compress)
+			assert(size < 40+4+6*5);
+		remove(filename);
+	}
+	assert(read_delta(0) == NULL);
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_delta(false);
+	test_delta(true);
+	return 0;
+}
@@ -0,0 +1,83 @@
+#include "Splitting.h"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <omp.h>
+using namespace std;
+
+const int nx = 20, ny = 40, nz = 5;
+const double age = 40.0;
+
+/**
+ * Fraction of hybrid patients with seeds from first_seed that have
+ * cancer at the age.
+ */
+double plain(unsigned long first_seed, int patients)
+{
+	int found = 0;
+	for (int n = 0; n < patients; n++)
+	{
+		Patient patient(first_seed+n,false,false,true);
+		int types[NUM_CELL_TYPES];
+		patient.run_to(age);
+		patient.count(types);
+		found += (types[CANCER] > 0);
+	}
+	return (double)found/(double)patients;
+}
+
+/**
+ * With no levels there is one stage and it simulates the same patients
+ * as plain Monte Carlo.
+ */
+void test_one_stage()
+{
+	cout << "TEST ONE STAGE" << endl;
+	SplitEstimate e = estimate_incidence(age,vector<int>(),50,4,1,false,false);
+	double p = 0.0;
+	for (int r = 0; r < 4; r++)
+		p += plain(1+r*50,50)/4.0;
+	cout << e.p << " " << p << endl;
+	assert(fabs(e.p-p) < 1E-12 && e.trajectories == 200);
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * The estimate with levels agrees with plain Monte Carlo and does not
+ * depend on the number of threads.
+ */
+void test_levels()
+{
+	cout << "TEST LEVELS" << endl;
+	vector<int> levels;
+	levels.push_back(1);
+	levels.push_back(20);
+	omp_set_num_threads(1);
+	SplitEstimate a = estimate_incidence(age,levels,100,10,1000,true,false);
+	omp_set_num_threads(4);
+	SplitEstimate b = estimate_incidence(age,levels,100,10,1000,true,false);
+	assert(a.p == b.p && a.std_error == b.std_error && a.events == b.events);
+	const int patients = 4000;
+	double p = plain(1,patients);
+	double se = sqrt(a.std_error*a.std_error+p*(1.0-p)/patients);
+	cout << a.p << " +/- " << a.std_error << " " << p << endl;
+	assert(a.p > 0.0 && fabs(a.p-p) < 4.0*se);
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	Parameters* p = Parameters::getInstance();
+	p->cell_size(1.0);
+	p->set_stem_cells_per_mm2(10.0);
+	p->xdim(nx);
+	p->ydim(ny);
+	p->zdim(nz);
+	p->be_onset_age(10.0);
+	p->set_diffusion_rate(0.5);
+	p->set_mutations_per_year(0.0001,BE);
+	p->set_mutations_per_year(0.000003,DYSPLASIA);
+	test_one_stage();
+	test_levels();
+	return 0;
+}
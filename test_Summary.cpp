@@ -0,0 +1,71 @@
+#include "Summary.h"
+#include "Random.h"
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+/**
+ * The mean and standard deviation must match those found with two
+ * passes over the stored values, even with a large offset.
+ */
+void test_moments()
+{
+	cout << "TEST MOMENTS" << endl;
+	Random rng(1);
+	Summary s;
+	vector<double> x;
+	for (int i = 0; i < 10000; i++)
+	{
+		x.push_back(1E6+rng.normal(3.0,2.0));
+		s.add(x.back());
+	}
+	double mean = 0.0, ss = 0.0;
+	for (auto v : x)
+		mean += v/x.size();
+	for (auto v : x)
+		ss += (v-mean)*(v-mean);
+	assert(s.count() == x.size());
+	assert(fabs(s.mean()-mean) < 1E-8);
+	assert(fabs(s.std_dev()-sqrt(ss/(x.size()-1))) < 1E-8);
+	assert(s.min() == *min_element(x.begin(),x.end()));
+	assert(s.max() == *max_element(x.begin(),x.end()));
+	cout << "TEST PASSED" << endl;
+}
+
+/**
+ * Quantiles of uniform and exponential values must be close to the
+ * true ones and those of a few values must be exact.
+ */
+void test_quantiles()
+{
+	cout << "TEST QUANTILES" << endl;
+	Random rng(2);
+	Summary u, e;
+	for (int i = 0; i < 100000; i++)
+	{
+		u.add(rng.uniform());
+		e.add(rng.exponential(1.0));
+	}
+	assert(fabs(u.q5()-0.05) < 0.01);
+	assert(fabs(u.median()-0.5) < 0.01);
+	assert(fabs(u.q95()-0.95) < 0.01);
+	assert(fabs(e.median()-log(2.0)) < 0.02);
+	assert(fabs(e.q95()+log(0.05)) < 0.05);
+	Summary few;
+	assert(few.count() == 0 && few.median() == 0.0 && few.std_dev() == 0.0);
+	few.add(3.0);
+	few.add(1.0);
+	few.add(2.0);
+	assert(few.median() == 2.0 && few.q5() == 1.0 && few.q95() == 3.0);
+	cout << "TEST PASSED" << endl;
+}
+
+int main()
+{
+	test_moments();
+	test_quantiles();
+	return 0;
+}
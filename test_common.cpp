@@ -19,7 +19,8 @@ void test_exponential()
 	}
 	double test_mean = (sum/(double)count);
 	cout << "Got mean = " << test_mean << endl;
-	assert(fabs(test_mean-mean) < 1E-4);
+	// Five standard errors of the sample mean
+	assert(fabs(test_mean-mean) < 5.0*mean/sqrt((double)count));
 	cout << "TEST PASSED" << endl;
 }
 
@@ -98,6 +99,35 @@ void test_wrap()
 	cout << "TEST PASSED" << endl;
 }
 
+void test_set()
+{
+	cout << "TEST SET" << endl;
+	Parameters* p = Parameters::getInstance();
+	assert(!p->set("no_such_parameter",1.0));
+	// The rates use the new cell size even if they are given first
+	assert(p->set("diffusion_rate",2.0));
+	assert(p->set("grid_size",0.5));
+	assert(p->set("circumference",10.0));
+	assert(p->set("length",20.25));
+	assert(p->set("thickness",3.0));
+	assert(p->set("layer_submucosa",0.3));
+	assert(p->set("be_onset_age",40.0));
+	// Nothing changes until the values are applied
+	assert(p->cell_size() == dx && p->xdim() == nx);
+	p->apply();
+	assert(p->cell_size() == 0.5);
+	assert(p->get_expand_interval() == 0.25/2.0);
+	assert(p->xdim() == 21 && p->ydim() == 41 && p->zdim() == 7);
+	assert(p->layer_fraction(SUBMUCOSA) == 0.3);
+	assert(p->layer_fraction(EPITHELIUM) == 0.2);
+	// Restore the grid for the other tests
+	p->cell_size(dx);
+	p->xdim(nx);
+	p->ydim(ny);
+	p->zdim(nz);
+	cout << "TEST PASSED" << endl;
+}
+
 int main()
 {
 	Parameters* p = Parameters::getInstance();
@@ -117,5 +147,6 @@ int main()
 	test_mutation_interval();
 	test_diffusion_rate();
 	test_wrap();
+	test_set();
 	return 0;
 }
@@ -0,0 +1,132 @@
+#include "esoabm.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define AGES 3
+#define MODELS 8
+
+static const double ages[AGES] = { 50.0, 60.0, 70.0 };
+
+/**
+ * A short segment of esophagus with fast dynamics. Model n has its own
+ * rate of dysplasia.
+ */
+static void small_params(esoabm_params* params, int n)
+{
+	esoabm_defaults(params);
+	params->be_onset_age = 40.0;
+	params->stem_cell_density = 3000.0;
+	params->length = 30.0;
+	params->diffusion_rate = 1.0;
+	params->mutate_be = 1E-7*(n+1);
+	params->mutate_dysplasia = 1E-6;
+	params->aggregate = 1;
+}
+
+/**
+ * Run model n by itself.
+ */
+static void run_alone(int n, int counts[AGES*ESOABM_TYPES])
+{
+	esoabm_params params;
+	small_params(&params,n);
+	esoabm_model* model = esoabm_create(&params,n,NULL,0);
+	assert(model != NULL);
+	assert(esoabm_run(model,ages,AGES,counts,NULL,NULL) == 0);
+	esoabm_destroy(model);
+}
+
+/**
+ * Models that are run one age at a time in turn, or all at once by
+ * many threads, have the same results as models that are run alone.
+ */
+static void test_reentrant(void)
+{
+	int alone[MODELS][AGES*ESOABM_TYPES], turns[MODELS][AGES*ESOABM_TYPES];
+	int threads[MODELS][AGES*ESOABM_TYPES];
+	esoabm_model* models[MODELS];
+	esoabm_params params;
+	int n, a, i, changed = 0;
+	printf("TEST REENTRANT\n");
+	for (n = 0; n < MODELS; n++)
+		run_alone(n,alone[n]);
+	for (n = 0; n < MODELS; n++)
+	{
+		small_params(&params,n);
+		models[n] = esoabm_create(&params,n,NULL,0);
+	}
+	for (a = 0; a < AGES; a++)
+		for (n = 0; n < MODELS; n++)
+			assert(esoabm_run(models[n],ages+a,1,turns[n]+a*ESOABM_TYPES,NULL,NULL) == 0);
+	for (n = 0; n < MODELS; n++)
+		esoabm_destroy(models[n]);
+	#pragma omp parallel for schedule(dynamic,1)
+	for (n = 0; n < MODELS; n++)
+		run_alone(n,threads[n]);
+	for (n = 0; n < MODELS; n++)
+		for (i = 0; i < AGES*ESOABM_TYPES; i++)
+		{
+			assert(alone[n][i] == turns[n][i] && alone[n][i] == threads[n][i]);
+			changed += (i%ESOABM_TYPES == 2 && alone[n][i] > 0);
+		}
+	assert(changed > 0);
+	printf("TEST PASSED\n");
+}
+
+static void test_errors(void)
+{
+	esoabm_params params;
+	char error[100];
+	double backwards[2] = { 60.0, 50.0 };
+	int counts[2*ESOABM_TYPES];
+	esoabm_model* model;
+	printf("TEST ERRORS\n");
+	esoabm_defaults(&params);
+	params.be_onset_age = 40.0;
+	assert(esoabm_create(&params,0,error,sizeof(error)) == NULL);
+	assert(strstr(error,"stem_cell_density") != NULL);
+	small_params(&params,0);
+	model = esoabm_create(&params,0,error,sizeof(error));
+	assert(model != NULL && esoabm_be_length(model) >= 0.0 && esoabm_be_onset(model) >= 0.0);
+	assert(esoabm_run(model,backwards,2,counts,NULL,NULL) == -1);
+	assert(esoabm_run(model,backwards,1,counts,NULL,NULL) == 0);
+	assert(esoabm_run(model,backwards+1,1,counts,NULL,NULL) == -1);
+	esoabm_destroy(model);
+	printf("TEST PASSED\n");
+}
+
+/**
+ * Surveillance of the BE segment finds BE in every endoscopy.
+ */
+static void test_protocol(void)
+{
+	esoabm_params params;
+	esoabm_protocol protocol;
+	int counts[AGES*ESOABM_TYPES];
+	double detected[AGES*ESOABM_TYPES];
+	esoabm_model* model;
+	int a;
+	printf("TEST PROTOCOL\n");
+	small_params(&params,3);
+	protocol.kind = ESOABM_SEATTLE;
+	protocol.param = 1.0;
+	protocol.endoscopies = 100;
+	model = esoabm_create(&params,5,NULL,0);
+	assert(esoabm_run(model,ages,AGES,counts,&protocol,detected) == 0);
+	for (a = 0; a < AGES; a++)
+	{
+		assert(counts[a*ESOABM_TYPES+1] == 0 || detected[a*ESOABM_TYPES+1] == 1.0);
+		assert(detected[a*ESOABM_TYPES+3] <= detected[a*ESOABM_TYPES+2]);
+	}
+	esoabm_destroy(model);
+	printf("TEST PASSED\n");
+}
+
+int main(void)
+{
+	test_reentrant();
+	test_errors();
+	test_protocol();
+	return 0;
+}